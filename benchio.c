@@ -0,0 +1,280 @@
+/*********************************************************************
+*
+*       file:           benchio.c
+*       author:         paul cardoos
+*
+*       scripted throughput benchmark for the device-independent
+*       i/o package for SAPC (replaces typing at testio.lnx)
+*
+*       Each measurement puts the UART in internal loopback, so no
+*       operator or cable is needed, then reports one CSV line:
+*
+*       bench,test,dev,size,bytes,kcycles,bytes_per_sec,
+*             ints_per_kb,idle_pct10,rxdropped
+*
+*       Echo is off: in loopback every echo would come back as input
+*       and be echoed again.  A run ends when the last byte written
+*       has come back in, so the time covers the whole trip.
+*
+*       idle_pct10 is the share of the run the CPU spent halted with
+*       no task to run (PIT0 LOADCONTROL), in tenths of a percent.
+*       "grep ^bench" on the mtip transcript gives a file to compare
+*       across driver versions.
+*/
+
+#include <stdio.h>              /* for lib's device # defs, protos */
+#include "io_public.h"		/* for our packages devs, API prototypes */
+#include "task.h"
+#include "tsc.h"
+
+#define BENCH_VERSION 3		/* bump when the output format changes */
+#define MAXWRITE 65536		/* largest single write */
+#define BENCHBYTES 4096		/* least data moved per measurement */
+#define MINCHAIN 64		/* smallest writechain buffer */
+
+char wbuf[MAXWRITE];
+char rbuf[NTTYS][MAXWRITE];
+struct iobuf chain[BENCHBYTES / MINCHAIN];
+unsigned int cpu_hz;		/* TSC cycles per second */
+
+/* what reader() is to take in, and when it had it all */
+int rx_total[NTTYS];
+unsigned long long rx_done[NTTYS];
+
+static unsigned long long run_start;
+static struct cpuload run_load;	/* at start_run */
+static unsigned long long run_idle; /* idle cycles, start_run to end_run */
+
+void bench_write(int dev, int size);
+void bench_read(int dev, int size);
+void bench_acquire(int dev, int size);
+void bench_chain(int dev, int size);
+void bench_dual(int size);
+void dual_writer(int dev);
+void reader(int dev);
+void start_run(int dev);
+void end_run(int dev);
+void report(char *test, int dev, int size, int bytes,
+	    unsigned long long cycles, struct ttystats *st);
+
+int main(void)
+{
+  int i, size, dev;
+  struct ttystats st;
+
+  for (i = 0; i < MAXWRITE; i++)
+    wbuf[i] = 'a' + i % 26;
+
+  ioinit();  /* Initialize devices */
+  cpu_hz = control(PIT0, CPUHZCONTROL, 0);
+  kprintf("bench,version,%d,cpu_hz,%u\n", BENCH_VERSION, cpu_hz);
+  kprintf("bench,test,dev,size,bytes,kcycles,bytes_per_sec,"
+	  "ints_per_kb,idle_pct10,rxdropped\n");
+
+  for (dev = TTY0; dev <= TTY1; dev++)
+    for (size = 1; size <= MAXWRITE; size *= 2)
+      bench_write(dev, size);
+
+  for (dev = TTY0; dev <= TTY1; dev++)
+    for (size = MINCHAIN; size <= MAXWRITE; size *= 2)
+      bench_chain(dev, size);
+
+  control(TTY0, STATSCONTROL, (int)&st);
+  for (dev = TTY0; dev <= TTY1; dev++)
+    for (size = 1; size <= st.inqsize; size *= 2) {
+      bench_read(dev, size);
+      bench_acquire(dev, size);
+    }
+
+  for (size = 1; size <= MAXWRITE; size *= 2)
+    bench_dual(size);
+  return 0;
+}
+
+/* write BENCHBYTES (or one write of size, if bigger) to dev, while
+ * a reader task takes it back in */
+void bench_write(int dev, int size)
+{
+  int done, t;
+  struct ttystats st;
+
+  start_run(dev);
+  rx_total[dev] = size < BENCHBYTES ? BENCHBYTES : size;
+  t = task_create(reader, dev);
+  for (done = 0; done < rx_total[dev]; done += size)
+    write(dev, wbuf, size);
+  task_join(t);
+  end_run(dev);
+  control(dev, STATSCONTROL, (int)&st);
+  report("write", dev, size, rx_total[dev], rx_done[dev] - run_start, &st);
+}
+
+/* loop size-char writes back to reads; size must fit in the input queue */
+void bench_read(int dev, int size)
+{
+  int done;
+  unsigned long long cycles;
+  struct ttystats st;
+
+  start_run(dev);
+  for (done = 0; done < BENCHBYTES; done += size) {
+    write(dev, wbuf, size);
+    read(dev, rbuf[dev], size);
+  }
+  cycles = rdtsc() - run_start;
+  end_run(dev);
+  control(dev, STATSCONTROL, (int)&st);
+  report("read", dev, size, done, cycles, &st);
+}
+
+/* same as bench_read, consuming input in place with read_acquire */
+void bench_acquire(int dev, int size)
+{
+  int done, got, n;
+  char *p;
+  unsigned long long cycles;
+  struct ttystats st;
+
+  start_run(dev);
+  for (done = 0; done < BENCHBYTES; done += size) {
+    write(dev, wbuf, size);
+    for (got = 0; got < size; got += n) {
+      read_acquire(dev, &p, &n);
+      if (n > size - got)
+	n = size - got;
+      read_release(dev, n);
+    }
+  }
+  cycles = rdtsc() - run_start;
+  end_run(dev);
+  control(dev, STATSCONTROL, (int)&st);
+  report("acquire", dev, size, done, cycles, &st);
+}
+
+/* same as bench_write, sent in place as a chain of size-char buffers */
+void bench_chain(int dev, int size)
+{
+  int i, n, t;
+  struct ttystats st;
+
+  n = size < BENCHBYTES ? BENCHBYTES / size : 1;
+  for (i = 0; i < n; i++) {
+    chain[i].data = wbuf + (i * size) % MAXWRITE;
+    chain[i].len = size;
+    chain[i].next = i + 1 < n ? &chain[i + 1] : 0;
+    chain[i].done = 0;
+  }
+  start_run(dev);
+  rx_total[dev] = n * size;
+  t = task_create(reader, dev);
+  writechain(dev, chain);
+  task_join(t);
+  end_run(dev);
+  control(dev, STATSCONTROL, (int)&st);
+  report("chain", dev, size, n * size, rx_done[dev] - run_start, &st);
+}
+
+static int dual_size;
+
+/* both ports at once: a writer task per port, a reader task for
+ * TTY1, and main reading TTY0 */
+void bench_dual(int size)
+{
+  int t0, t1, r1;
+  unsigned long long end;
+  struct ttystats st0, st1;
+
+  dual_size = size;
+  rx_total[TTY0] = rx_total[TTY1] = size < BENCHBYTES ? BENCHBYTES : size;
+  start_run(TTY0);
+  start_run(TTY1);
+  t0 = task_create(dual_writer, TTY0);
+  t1 = task_create(dual_writer, TTY1);
+  r1 = task_create(reader, TTY1);
+  reader(TTY0);
+  task_join(t0);
+  task_join(t1);
+  task_join(r1);
+  end = rx_done[TTY0] > rx_done[TTY1] ? rx_done[TTY0] : rx_done[TTY1];
+  end_run(TTY0);
+  end_run(TTY1);
+  control(TTY0, STATSCONTROL, (int)&st0);
+  control(TTY1, STATSCONTROL, (int)&st1);
+  /* combine the two ports' counters */
+  st0.ints += st1.ints;
+  st0.rxdropped += st1.rxdropped;
+  report("dual", -1, size, 2 * rx_total[TTY0], end - run_start, &st0);
+}
+
+void dual_writer(int dev)
+{
+  int done;
+
+  for (done = 0; done < rx_total[dev]; done += dual_size)
+    write(dev, wbuf, dual_size);
+}
+
+/* Take rx_total[dev] chars back in, as fast as they come, and note
+ * when the last one did.  Blocking in read is safe only while no
+ * input has been lost: then a reader waiting on an empty queue is
+ * sure to get the next char.  After a drop, poll the tick instead,
+ * and count the lost chars as in. */
+void reader(int dev)
+{
+  int got, n;
+  struct ttystats st;
+
+  for (got = 0; got < rx_total[dev]; got += n) {
+    if ((n = control(dev, READYCONTROL, 0)) == 0) {
+      control(dev, STATSCONTROL, (int)&st);
+      if (st.rxdropped) {
+	if (got + st.rxdropped >= rx_total[dev])
+	  break;
+	control(PIT0, SLEEPCONTROL, 1);
+	continue;
+      }
+      n = 1;			/* wait for the next one */
+    }
+    if (n > rx_total[dev] - got)
+      n = rx_total[dev] - got;
+    read(dev, rbuf[dev] + got, n);
+  }
+  rx_done[dev] = rdtsc();
+}
+
+void start_run(int dev)
+{
+  control(dev, LOOPCONTROL, 1);	/* keep test data off the wire */
+  control(dev, ECHOCONTROL, 0);	/* else each echo is echoed again */
+  control(dev, FLUSHCONTROL, 0);
+  control(dev, STATSRESET, 0);
+  control(PIT0, LOADCONTROL, (int)&run_load);
+  run_start = rdtsc();
+}
+
+/* everything written has come back in, so the line is idle: restore
+ * dev */
+void end_run(int dev)
+{
+  struct cpuload now;
+
+  control(PIT0, LOADCONTROL, (int)&now);
+  run_idle = now.idle - run_load.idle;
+  control(dev, LOOPCONTROL, 0);
+  control(dev, FLUSHCONTROL, 0);
+  control(dev, ECHOCONTROL, 1);
+}
+
+void report(char *test, int dev, int size, int bytes,
+	    unsigned long long cycles, struct ttystats *st)
+{
+  unsigned int bps, ints_per_kb, idle;
+
+  /* scale cycles down by 256 so the divisors fit in 32 bits */
+  bps = div64_32((unsigned long long)bytes * cpu_hz, cycles >> 8) >> 8;
+  ints_per_kb = div64_32((unsigned long long)st->ints * 1024, bytes);
+  idle = div64_32((run_idle >> 8) * 1000, cycles >> 8);
+  kprintf("bench,%s,%d,%d,%d,%u,%u,%u,%u,%u\n", test, dev, size, bytes,
+	  (unsigned int)(cycles >> 10), bps, ints_per_kb, idle,
+	  st->rxdropped);
+}
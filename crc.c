@@ -0,0 +1,89 @@
+/*********************************************************************
+*
+*       file:           crc.c
+*       author:         paul cardoos
+*
+*       CRC-16/CRC-32 by slicing-by-4 (see crc.h)
+*
+*       tab[0] is the usual one-byte table; tab[k][b] is the CRC of
+*       byte b followed by k zero bytes, so four table lookups fold
+*       in a whole 32-bit word.  The SAPC is little-endian, so the
+*       word's low byte is the first byte of the data.
+*
+*/
+#include "crc.h"
+
+#define CRC16_POLY 0x8408	/* 0x1021 bit-reversed */
+#define CRC32_POLY 0xedb88320	/* 0x04c11db7 bit-reversed */
+
+static unsigned short crc16_tab[4][256];
+static unsigned int crc32_tab[4][256];
+static int crc_ready;
+
+void crc_init(void)
+{
+  unsigned int c16, c32;
+  int b, k;
+
+  if (crc_ready)
+    return;
+  for (b = 0; b < 256; b++) {
+    c16 = c32 = b;
+    for (k = 0; k < 8; k++) {
+      c16 = c16 & 1 ? (c16 >> 1) ^ CRC16_POLY : c16 >> 1;
+      c32 = c32 & 1 ? (c32 >> 1) ^ CRC32_POLY : c32 >> 1;
+    }
+    crc16_tab[0][b] = c16;
+    crc32_tab[0][b] = c32;
+  }
+  for (b = 0; b < 256; b++)
+    for (k = 1; k < 4; k++) {
+      c16 = crc16_tab[k-1][b];
+      crc16_tab[k][b] = (c16 >> 8) ^ crc16_tab[0][c16 & 0xff];
+      c32 = crc32_tab[k-1][b];
+      crc32_tab[k][b] = (c32 >> 8) ^ crc32_tab[0][c32 & 0xff];
+    }
+  crc_ready = 1;
+}
+
+/* the little-endian word at p, from its bytes: loading it through
+   an (unsigned int *) breaks C's aliasing rules; gcc -O makes this
+   one load again */
+#define LOAD4(p) \
+  ((p)[0] | (p)[1] << 8 | (p)[2] << 16 | (unsigned int)(p)[3] << 24)
+
+unsigned int crc16(unsigned int crc, char *buf, int n)
+{
+  unsigned char *p = (unsigned char *)buf;
+  unsigned int w;
+
+  crc = ~crc & 0xffff;
+  for (; n > 0 && ((unsigned long)p & 3); n--)	/* up to a word boundary */
+    crc = (crc >> 8) ^ crc16_tab[0][(crc ^ *p++) & 0xff];
+  for (; n >= 4; n -= 4, p += 4) {
+    w = LOAD4(p) ^ crc;
+    crc = crc16_tab[3][w & 0xff] ^ crc16_tab[2][(w >> 8) & 0xff] ^
+          crc16_tab[1][(w >> 16) & 0xff] ^ crc16_tab[0][w >> 24];
+  }
+  for (; n > 0; n--)
+    crc = (crc >> 8) ^ crc16_tab[0][(crc ^ *p++) & 0xff];
+  return ~crc & 0xffff;
+}
+
+unsigned int crc32(unsigned int crc, char *buf, int n)
+{
+  unsigned char *p = (unsigned char *)buf;
+  unsigned int w;
+
+  crc = ~crc;
+  for (; n > 0 && ((unsigned long)p & 3); n--)	/* up to a word boundary */
+    crc = (crc >> 8) ^ crc32_tab[0][(crc ^ *p++) & 0xff];
+  for (; n >= 4; n -= 4, p += 4) {
+    w = LOAD4(p) ^ crc;
+    crc = crc32_tab[3][w & 0xff] ^ crc32_tab[2][(w >> 8) & 0xff] ^
+          crc32_tab[1][(w >> 16) & 0xff] ^ crc32_tab[0][w >> 24];
+  }
+  for (; n > 0; n--)
+    crc = (crc >> 8) ^ crc32_tab[0][(crc ^ *p++) & 0xff];
+  return ~crc;
+}
@@ -0,0 +1,23 @@
+/*********************************************************************
+*
+*       file:           crc.h
+*       author:         paul cardoos
+*
+*       table-driven CRC-16 and CRC-32, sliced 4 bytes at a time
+*
+*       CRC-16 is the X.25/HDLC FCS (poly 0x1021 reflected, init and
+*       xorout 0xffff), CRC-32 the IEEE 802.3/zlib one.  Both calls
+*       continue a CRC: pass 0 to start, or the value returned for
+*       the data so far, so a stream can be done in pieces.
+*
+*/
+
+#ifndef CRC_H
+#define CRC_H
+
+/* fill in the tables; call once before the others */
+void crc_init(void);
+unsigned int crc16(unsigned int crc, char *buf, int n);
+unsigned int crc32(unsigned int crc, char *buf, int n);
+
+#endif
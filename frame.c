@@ -0,0 +1,120 @@
+/*********************************************************************
+*
+*       file:           frame.c
+*       author:         paul cardoos
+*
+*       SLIP and COBS framing (see frame.h)
+*
+*       COBS: each block is a code char c, then c-1 data chars; the
+*       block stands for those chars and a 0, except that c = 0xff
+*       has no 0 after it and the frame's last 0 is left off.  The
+*       frame ends with a 0 char, which can't occur anywhere else.
+*
+*/
+#include "frame.h"
+
+void frame_reset(struct framer *f, int mode)
+{
+  f->mode = mode;
+  f->len = 0;
+  f->esc = 0;
+  f->left = 0;
+  f->zero = 0;
+  f->bad = 0;
+}
+
+/* add a decoded char, marking the frame bad if it's too long */
+static void add(struct framer *f, int ch)
+{
+  if (f->len < FRAMEMAX)
+    f->buf[f->len++] = ch;
+  else
+    f->bad = 1;
+}
+
+/* frame delimiter seen: hand back the frame if there is a good one */
+static int end(struct framer *f, int ok)
+{
+  int len = f->len;
+  int bad = f->bad || !ok;
+
+  frame_reset(f, f->mode);
+  if (bad)
+    return FRAME_BAD;
+  return len ? len : FRAME_MORE; /* empty frames are just line noise */
+}
+
+int frame_rx(struct framer *f, int ch)
+{
+  ch &= 0xff;
+  if (f->mode == FRAME_SLIP) {
+    if (ch == SLIP_END)
+      return end(f, !f->esc);
+    if (f->esc) {
+      f->esc = 0;
+      if (ch == SLIP_ESC_END)
+	ch = SLIP_END;
+      else if (ch == SLIP_ESC_ESC)
+	ch = SLIP_ESC;
+      else
+	f->bad = 1;		/* protocol violation */
+    } else if (ch == SLIP_ESC) {
+      f->esc = 1;
+      return FRAME_MORE;
+    }
+    add(f, ch);
+    return FRAME_MORE;
+  }
+
+  /* COBS */
+  if (ch == 0)
+    return end(f, f->left == 0); /* ending mid-block is an error */
+  if (f->left == 0) {		/* a code char */
+    if (f->zero)
+      add(f, 0);
+    f->left = ch - 1;
+    f->zero = ch < 0xff;
+  } else {
+    add(f, ch);
+    f->left--;
+  }
+  return FRAME_MORE;
+}
+
+void frame_tx(int mode, char *buf, int n, void (*put)(void *arg, int ch),
+	      void *arg)
+{
+  int i, len, run, ch;
+
+  if (mode == FRAME_SLIP) {
+    put(arg, SLIP_END);		/* flush any line noise at the receiver */
+    for (i = 0; i < n; i++) {
+      ch = buf[i] & 0xff;
+      if (ch == SLIP_END) {
+	put(arg, SLIP_ESC);
+	put(arg, SLIP_ESC_END);
+      } else if (ch == SLIP_ESC) {
+	put(arg, SLIP_ESC);
+	put(arg, SLIP_ESC_ESC);
+      } else
+	put(arg, ch);
+    }
+    put(arg, SLIP_END);
+    return;
+  }
+
+  /* COBS: one block per run of non-0 chars, at most 254 long */
+  i = 0;
+  for (;;) {
+    for (run = 0; i + run < n && buf[i + run] != 0 && run < 254; run++)
+      ;
+    put(arg, run + 1);
+    for (len = run; len > 0; len--)
+      put(arg, buf[i++] & 0xff);
+    if (i == n)
+      break;			/* trailing 0 implied, or none after 0xff */
+    if (run < 254)
+      i++;			/* the 0 here is implied by the block */
+  }
+  put(arg, 0);
+}
@@ -0,0 +1,46 @@
+/*********************************************************************
+*
+*       file:           frame.h
+*       author:         paul cardoos
+*
+*       SLIP (RFC 1055) and COBS packet framing for byte streams:
+*       a decoder fed one char at a time (from an ISR), and an
+*       encoder that hands out chars through a put function
+*
+*/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "tty_public.h"		/* FRAME_SLIP, FRAME_COBS, FRAMEMAX */
+
+/* SLIP special chars */
+#define SLIP_END 0300
+#define SLIP_ESC 0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+/* frame_rx return values, besides a frame length */
+#define FRAME_MORE (-1)		/* frame not complete yet */
+#define FRAME_BAD (-2)		/* malformed or too long: discarded */
+
+struct framer {
+  int mode;			/* FRAME_SLIP or FRAME_COBS */
+  int len;			/* chars decoded so far */
+  int esc;			/* SLIP: last char was SLIP_ESC */
+  int left;			/* COBS: data chars left in this block */
+  int zero;			/* COBS: a 0 goes before the next block */
+  int bad;			/* skip to the next delimiter */
+  char buf[FRAMEMAX];		/* the frame being decoded */
+};
+
+/* start decoding in mode */
+void frame_reset(struct framer *f, int mode);
+/* decode one char: returns the frame length when one is complete
+   (frame in f->buf), else FRAME_MORE or FRAME_BAD */
+int frame_rx(struct framer *f, int ch);
+/* encode n chars of buf as one frame, passing each wire char to put */
+void frame_tx(int mode, char *buf, int n, void (*put)(void *arg, int ch),
+	      void *arg);
+
+#endif
@@ -58,3 +58,79 @@ int control(int dev, int fncode, int val)  /* note: val could be pointer */
   if (dev < 0 || dev >= NDEVS) return -1;          /* fail */
   return devtab[dev].dvcontrol(dev, fncode, val); /* dev-specific routine */
 }
+
+/*====================================================================
+*
+*       zero-copy read calling routines, via the device control fn
+*
+*/
+int read_acquire(int dev, char **ptr, int *len)
+{
+  struct ioreq req;
+
+  if (dev < 0 || dev >= NDEVS) return -1;       /* fail */
+  if (devtab[dev].dvcontrol(dev, IOC_ACQUIRE, (int)&req) < 0)
+    return -1;
+  *ptr = req.buf;
+  *len = req.n;
+  return req.n;
+}
+
+int read_release(int dev, int n)
+{
+  struct ioreq req;
+
+  if (dev < 0 || dev >= NDEVS) return -1;       /* fail */
+  req.n = n;
+  return devtab[dev].dvcontrol(dev, IOC_RELEASE, (int)&req);
+}
+
+/*====================================================================
+*
+*       record read calling routine, via the device control fn
+*
+*/
+int readuntil(int dev, char *buf, int max, int delim)
+{
+  struct ioreq req;
+
+  if (dev < 0 || dev >= NDEVS) return -1;       /* fail */
+  req.buf = buf;
+  req.n = max;
+  req.arg = delim;
+  if (devtab[dev].dvcontrol(dev, IOC_READUNTIL, (int)&req) < 0)
+    return -1;
+  return req.n;
+}
+
+/*====================================================================
+*
+*       timestamped read calling routine, via the device control fn
+*
+*/
+int readts(int dev, char *buf, unsigned short *ts, int nchar)
+{
+  struct ioreq req;
+
+  if (dev < 0 || dev >= NDEVS) return -1;       /* fail */
+  req.buf = buf;
+  req.ts = ts;
+  req.n = nchar;
+  if (devtab[dev].dvcontrol(dev, IOC_READTS, (int)&req) < 0)
+    return -1;
+  return req.n;
+}
+
+/*====================================================================
+*
+*       zero-copy write calling routine, via the device control fn
+*
+*/
+int writechain(int dev, struct iobuf *chain)
+{
+  struct ioreq req;
+
+  if (dev < 0 || dev >= NDEVS) return -1;       /* fail */
+  req.chain = chain;
+  return devtab[dev].dvcontrol(dev, IOC_WRITECHAIN, (int)&req);
+}
@@ -11,6 +11,20 @@
 #define IO_PUBLIC_H
 
 #include "tty_public.h"
+#include "pit_public.h"
+#include "mux_public.h"
+
+/* a caller-owned buffer for writechain: the driver sends len chars
+   from data in place, then calls done(b) (at interrupt level, ints
+   off) once the last of them is in the UART; until then it belongs
+   to the driver, next included, and done may queue it again */
+struct iobuf {
+  char *data;
+  int len;
+  struct iobuf *next;		/* rest of the chain, or 0 */
+  void (*done)(struct iobuf *b); /* or 0 */
+  void *arg;			/* for done's use */
+};
 
 /* initialize io package*/
 void ioinit(void);
@@ -20,5 +34,19 @@ int read(int dev, char *buf, int nchar);
 int write(int dev, char *buf, int nchar);
 /* misc. device functions */
 int control(int dev, int fncode, int val);
+/* zero-copy read: wait for input, then point *ptr at *len chars of it
+   inside the driver's buffer (returns *len, or -1 if not supported) */
+int read_acquire(int dev, char **ptr, int *len);
+/* done with the first n chars from read_acquire */
+int read_release(int dev, int n);
+/* read a record: up to and including delim, or max chars, whichever
+   comes first (returns the count, or -1 if not supported) */
+int readuntil(int dev, char *buf, int max, int delim);
+/* read nchar chars, and for each the time since the one before it
+   arrived (see TSCONTROL; returns nchar, or -1 if not supported) */
+int readts(int dev, char *buf, unsigned short *ts, int nchar);
+/* send a chain of buffers after what is already written, without
+   copying, and return at once (0, or -1 if not supported) */
+int writechain(int dev, struct iobuf *chain);
 
 #endif
@@ -9,8 +9,16 @@
 
 #include "ioconf.h"
 #include "tty.h"
+#include "pit.h"
+#include "mux.h"
 
 struct	device	devtab[] = {
 {0,ttyinit, ttyread, ttywrite, ttycontrol, 0x3f8,(int)&ttytab[0]}, /* TTY0 */
 {1,ttyinit, ttyread, ttywrite, ttycontrol, 0x2f8,(int)&ttytab[1]},/* TTY1*/
+{2,pitinit, pitread, pitwrite, pitcontrol, 0x40,(int)&pittab[0]}, /* PIT0 */
+/* mux channels: the "base port" is the tty they share */
+{3,muxinit, muxread, muxwrite, muxcontrol, TTY1,(int)&muxtab[0]}, /* MUX0 */
+{4,muxinit, muxread, muxwrite, muxcontrol, TTY1,(int)&muxtab[1]}, /* MUX1 */
+{5,muxinit, muxread, muxwrite, muxcontrol, TTY1,(int)&muxtab[2]}, /* MUX2 */
+{6,muxinit, muxread, muxwrite, muxcontrol, TTY1,(int)&muxtab[3]}, /* MUX3 */
 };
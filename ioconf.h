@@ -22,6 +22,27 @@ struct  device  {               /* device table entry */
 
 extern	struct	device devtab[]; /* one struct per device */
 
+/* control codes for the io.c calls beyond read/write/control, passed
+ * to dvcontrol with val = (int)&struct ioreq; device control routines
+ * that don't support one return -1 */
+#define IOC_ACQUIRE 100		/* sets buf, n: unread input, in place */
+#define IOC_RELEASE 101		/* n: chars from IOC_ACQUIRE now used */
+#define IOC_READUNTIL 102	/* read into buf, at most n chars, through
+				   the first arg; sets n to the count */
+#define IOC_READTS 103		/* read n chars into buf, and their arrival
+				   times into ts */
+#define IOC_WRITECHAIN 104	/* queue chain for output, no copying */
+
+struct iobuf;			/* io_public.h */
+
+struct ioreq {
+  char *buf;
+  int n;
+  int arg;			/* IOC_READUNTIL: the delimiter */
+  unsigned short *ts;		/* IOC_READTS: a time for each char */
+  struct iobuf *chain;		/* IOC_WRITECHAIN: the buffers */
+};
+
 /* Note this needs to agree with # devs in ioconf.c */
-#define NDEVS 2
+#define NDEVS 7
 #endif
@@ -0,0 +1,217 @@
+/*********************************************************************
+*
+*       file:           klog.c
+*       author:         paul cardoos
+*
+*       buffered kernel printing: format, queue, let the tty ISR
+*       send it (see klog.h)
+*
+*       Messages are formatted straight into an mpsc ring slot with
+*       interrupts on, then whoever gets to drain() first moves them
+*       into logq, the char ring the tty sends.  Only that move, a
+*       message at a time, needs cli().
+*
+*/
+#include <stdio.h>  /* for kprintf prototype */
+#include <stdarg.h>
+#include <cpu.h>
+#include "io_public.h"
+#include "queue/queue.h"
+#include "tty.h"
+#include "mpsc.h"
+#include "klog.h"
+
+struct klogmsg {
+  int len;
+  char text[KLOGLINE];
+};
+
+static char msg_mem[sizeof(struct klogmsg) * KLOGMSGS];
+static unsigned int msg_seq[KLOGMSGS];
+static struct mpsc msgs;	/* formatted, not yet in logq */
+static volatile int draining;	/* someone is in drain() */
+static Queue logq;		/* for the tty to send */
+static int logdev = -1;		/* tty sending it, once klog_init runs */
+static volatile unsigned int dropped; /* no room in logq */
+
+static int format(char *buf, int size, char *fmt, va_list ap);
+static void drain(void);
+
+int klog_init(int dev)
+{
+  mpsc_init(&msgs, msg_mem, msg_seq, sizeof(struct klogmsg), KLOGMSGS);
+  init_queue(&logq, KLOGBUF);
+  dropped = 0;
+  if (tty_attach_log(dev, &logq) < 0)
+    return -1;			/* framed or compressed: stay kprintf */
+  logdev = dev;
+  return 0;
+}
+
+int klogf(char *fmt, ...)
+{
+  char buf[KLOGLINE];
+  struct klogmsg *m;
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  if (logdev < 0) {
+    format(buf, KLOGLINE, fmt, ap);
+    va_end(ap);
+    return kprintf("%s", buf);
+  }
+  if ((m = mpsc_reserve(&msgs)) == 0) {
+    va_end(ap);
+    return 0;			/* counted in msgs.fails */
+  }
+  len = m->len = format(m->text, KLOGLINE, fmt, ap);
+  va_end(ap);
+  mpsc_commit(&msgs, m);
+  drain();
+  return len;
+}
+
+void klog_flush(void)
+{
+  if (logdev >= 0) {
+    drain();
+    control(logdev, DRAINCONTROL, 0);
+  }
+}
+
+unsigned int klog_dropped(void)
+{
+  return dropped + msgs.fails;
+}
+
+/* Move committed messages to logq, \n as \r\n like kprintf.  One
+ * caller at a time: one that finds another at it (e.g. an ISR that
+ * interrupted it) leaves its message to that one, which looks again
+ * after letting go, so nothing is left behind. */
+static void drain(void)
+{
+  struct klogmsg *m;
+  int i, crs, saved_eflags;
+
+  do {
+    if (__sync_lock_test_and_set(&draining, 1))
+      return;
+    while ((m = mpsc_peek(&msgs)) != 0) {
+      for (i = crs = 0; i < m->len; i++)
+	crs += m->text[i] == '\n';
+      saved_eflags = get_eflags();
+      cli();			/* the tty ISR empties logq */
+      if (logq.max - 1 - queuecount(&logq) < m->len + crs)
+	dropped++;
+      else
+	for (i = 0; i < m->len; i++) {
+	  if (m->text[i] == '\n')
+	    enqueue(&logq, '\r');
+	  enqueue(&logq, m->text[i]);
+	}
+      tty_kick(logdev);
+      set_eflags(saved_eflags);
+      mpsc_release(&msgs);
+    }
+    __sync_lock_release(&draining);
+  } while (mpsc_peek(&msgs));
+}
+
+/*====================================================================
+*       formatter (no vsprintf in the SAPC library)
+====================================================================*/
+
+/* put fmt's output in buf, NUL-terminated and truncated to fit
+ * size; returns its length */
+static int format(char *buf, int size, char *fmt, va_list ap)
+{
+  char num[12], *s;
+  int n, width, left, zero, len, neg, d;
+  unsigned int u, base;
+  char *digits;
+
+  n = 0;
+  for (; *fmt && n < size - 1; fmt++) {
+    if (*fmt != '%') {
+      buf[n++] = *fmt;
+      continue;
+    }
+    left = zero = width = 0;
+    for (fmt++; *fmt == '-' || *fmt == '0'; fmt++)
+      if (*fmt == '-')
+	left = 1;
+      else
+	zero = 1;
+    for (; *fmt >= '0' && *fmt <= '9'; fmt++)
+      width = width * 10 + *fmt - '0';
+    if (*fmt == 'l')
+      fmt++;
+
+    /* make the field in s, len chars */
+    neg = 0;
+    base = 10;
+    digits = "0123456789abcdef";
+    switch (*fmt) {
+    case 'd':
+    case 'i':
+      d = va_arg(ap, int);
+      neg = d < 0;
+      u = neg ? -(unsigned int)d : (unsigned int)d;
+      break;
+    case 'X':
+      digits = "0123456789ABCDEF";
+      /* fall through */
+    case 'x':
+    case 'p':
+      base = 16;
+      /* fall through */
+    case 'u':
+      u = va_arg(ap, unsigned int);
+      break;
+    case 'c':
+      num[0] = va_arg(ap, int);
+      s = num;
+      len = 1;
+      goto pad;
+    case 's':
+      s = va_arg(ap, char *);
+      if (!s)
+	s = "(null)";
+      for (len = 0; s[len]; len++)
+	;
+      goto pad;
+    case 0:
+      fmt--;			/* lone % at the end */
+      continue;
+    default:			/* %% and unknowns: the char itself */
+      num[0] = *fmt;
+      s = num;
+      len = 1;
+      goto pad;
+    }
+    s = num + sizeof(num);	/* digits, backward from the end */
+    do {
+      *--s = digits[u % base];
+      u /= base;
+    } while (u);
+    if (neg) {
+      if (zero) {		/* sign goes ahead of the zeros */
+	buf[n++] = '-';
+	width--;
+      } else
+	*--s = '-';
+    }
+    len = num + sizeof(num) - s;
+
+  pad:
+    for (; !left && width > len && n < size - 1; width--)
+      buf[n++] = zero ? '0' : ' ';
+    for (d = 0; d < len && n < size - 1; d++)
+      buf[n++] = s[d];
+    for (; left && width > len && n < size - 1; width--)
+      buf[n++] = ' ';
+  }
+  buf[n] = 0;
+  return n;
+}
@@ -0,0 +1,46 @@
+/*********************************************************************
+*
+*       file:           klog.h
+*       author:         paul cardoos
+*
+*       buffered kernel/debug printing through the tty driver, for
+*       use after ioinit in place of kprintf, which polls the UART
+*       with interrupts off for the whole time a message takes
+*
+*       klogf formats into a log ring and returns at once; the tty
+*       transmit interrupt sends the ring after the device's queued
+*       output, and a later write() to the device waits its turn
+*       behind what was logged before it.  If the ring is full the
+*       whole message is dropped (and counted), never waited for.
+*       While the device has framing or LZ on, the ring is held
+*       rather than sent into the stream, and goes out when that
+*       mode is turned off.
+*
+*       klogf may be called from interrupt handlers too, and from
+*       code they interrupt: messages are reserved and formatted in
+*       a lock-free ring (mpsc.h) with interrupts left on.
+*
+*       Formats: %d %i %u %x %X %c %s %p %%, with - 0 and a width;
+*       l is accepted and ignored (int and long are the same size).
+*
+*/
+
+#ifndef KLOG_H
+#define KLOG_H
+
+#define KLOGBUF 1000		/* log ring size, under MAXCHARBUF */
+#define KLOGLINE 128		/* longest message, after formatting */
+#define KLOGMSGS 8		/* messages being formatted or moved to the
+				   log ring at once, power of two */
+
+/* send log output to tty dev from now on; -1 (and klogf stays
+   kprintf) if dev has framing or LZ on */
+int klog_init(int dev);
+/* log a message; before klog_init this is just kprintf */
+int klogf(char *fmt, ...);
+/* wait until everything logged so far has been sent */
+void klog_flush(void);
+/* messages dropped because the ring was full */
+unsigned int klog_dropped(void);
+
+#endif
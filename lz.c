@@ -0,0 +1,184 @@
+/*********************************************************************
+*
+*       file:           lz.c
+*       author:         paul cardoos
+*
+*       small-window LZ77 compression (see lz.h)
+*
+*/
+#include "lz.h"
+
+/* decoder states */
+#define LZ_CODE 0		/* next char is a token */
+#define LZ_LIT 1		/* next count chars are literals */
+#define LZ_OFF 2		/* next char is a copy offset */
+#define LZ_COPY 3		/* count chars to copy from offset back */
+
+#define HASH(p) ((((p)[0] << 5) ^ ((p)[1] << 2) ^ (p)[2]) & (LZ_HASH - 1))
+
+void lz_enc_init(struct lzenc *e)
+{
+  int i;
+
+  e->pos = 0;
+  for (i = 0; i < LZ_HASH; i++)
+    e->head[i] = -1;
+}
+
+/* drop all but the last LZ_WIN chars of history */
+static void slide(struct lzenc *e)
+{
+  int i, shift = e->pos - LZ_WIN;
+
+  for (i = 0; i < LZ_WIN; i++)
+    e->win[i] = e->win[i + shift];
+  e->pos = LZ_WIN;
+  for (i = 0; i < LZ_HASH; i++)
+    e->head[i] = e->head[i] >= shift ? e->head[i] - shift : -1;
+}
+
+static void put_literals(unsigned char *p, int n,
+			 void (*put)(void *arg, int ch), void *arg)
+{
+  int run;
+
+  while (n > 0) {
+    run = n < LZ_MAXLIT ? n : LZ_MAXLIT;
+    put(arg, run - 1);
+    n -= run;
+    while (run-- > 0)
+      put(arg, *p++);
+  }
+}
+
+void lz_encode(struct lzenc *e, char *buf, int n,
+	       void (*put)(void *arg, int ch), void *arg)
+{
+  int chunk, i, end, lit, cand, len, mend, h;
+  unsigned char *w = e->win;
+
+  while (n > 0) {
+    chunk = n < LZ_WIN ? n : LZ_WIN;
+    if (e->pos + chunk > 2 * LZ_WIN)
+      slide(e);
+    for (i = 0; i < chunk; i++)
+      w[e->pos + i] = buf[i];
+    buf += chunk;
+    n -= chunk;
+
+    /* matches may start in history but must end inside this chunk */
+    i = lit = e->pos;
+    end = e->pos + chunk;
+    while (i + LZ_MINMATCH <= end) {
+      h = HASH(w + i);
+      cand = e->head[h];
+      e->head[h] = i;
+      if (cand >= 0 && i - cand <= LZ_WIN && w[cand] == w[i] &&
+	  w[cand + 1] == w[i + 1] && w[cand + 2] == w[i + 2]) {
+	for (len = LZ_MINMATCH;
+	     i + len < end && len < LZ_MAXMATCH && w[cand + len] == w[i + len];
+	     len++)
+	  ;
+	put_literals(w + lit, i - lit, put, arg);
+	put(arg, 0x80 | (len - LZ_MINMATCH));
+	put(arg, i - cand - 1);
+	mend = i + len;
+	for (i++; i < mend && i + LZ_MINMATCH <= end; i++)
+	  e->head[HASH(w + i)] = i; /* so later text can match in here */
+	i = lit = mend;
+      } else
+	i++;
+    }
+    put_literals(w + lit, end - lit, put, arg);
+    e->pos = end;
+  }
+}
+
+void lz_dec_init(struct lzdec *d)
+{
+  int i;
+
+  for (i = 0; i < LZ_WIN; i++)
+    d->hist[i] = 0;
+  d->hpos = 0;
+  d->state = LZ_CODE;
+  d->count = 0;
+  d->back = 0;
+}
+
+static int output(struct lzdec *d, int ch)
+{
+  d->hist[d->hpos] = ch;
+  d->hpos = (d->hpos + 1) % LZ_WIN;
+  return ch;
+}
+
+int lz_input(struct lzdec *d, int ch)
+{
+  ch &= 0xff;
+  switch (d->state) {
+  case LZ_CODE:
+    if (ch & 0x80) {
+      d->count = (ch & 0x7f) + LZ_MINMATCH;
+      d->state = LZ_OFF;
+    } else {
+      d->count = ch + 1;
+      d->state = LZ_LIT;
+    }
+    return LZ_NONE;
+  case LZ_LIT:
+    if (--d->count == 0)
+      d->state = LZ_CODE;
+    return output(d, ch);
+  case LZ_OFF:
+    /* ch+1 back from hpos, modulo LZ_WIN; stays fixed as hpos moves */
+    d->back = LZ_WIN - 1 - ch;
+    d->state = LZ_COPY;
+    return LZ_NONE;
+  }
+  return LZ_NONE;		/* LZ_COPY: caller should use lz_next */
+}
+
+int lz_next(struct lzdec *d)
+{
+  if (d->state != LZ_COPY)
+    return LZ_NONE;
+  if (--d->count == 0)
+    d->state = LZ_CODE;
+  return output(d, d->hist[(d->hpos + d->back) % LZ_WIN]);
+}
+
+/* run lz_input's state machine over the input, counting output only */
+int lz_ready(struct lzdec *d, int (*get)(void *arg, int k), void *arg)
+{
+  int state = d->state, count = d->count, n = 0, k = 0, ch;
+
+  for (;;) {
+    if (state == LZ_COPY) {
+      n += count;
+      state = LZ_CODE;
+      continue;
+    }
+    if ((ch = get(arg, k++)) == LZ_NONE)
+      return n;
+    switch (state) {
+    case LZ_CODE:
+      if (ch & 0x80) {
+	count = (ch & 0x7f) + LZ_MINMATCH;
+	state = LZ_OFF;
+      } else {
+	count = ch + 1;
+	state = LZ_LIT;
+      }
+      break;
+    case LZ_LIT:
+      n++;
+      if (--count == 0)
+	state = LZ_CODE;
+      break;
+    case LZ_OFF:
+      state = LZ_COPY;
+      break;
+    }
+  }
+}
@@ -0,0 +1,59 @@
+/*********************************************************************
+*
+*       file:           lz.h
+*       author:         paul cardoos
+*
+*       small-window LZ77 stream compression for serial links
+*
+*       The compressed stream is a series of tokens:
+*         c = 0x00-0x7f: c+1 literal chars follow
+*         c = 0x80-0xff: copy (c & 0x7f) + LZ_MINMATCH chars from
+*                        o+1 chars back, where o is the next char
+*       Both ends keep only the last LZ_WIN chars, and the encoder
+*       tries a single hash candidate per position, so memory and
+*       time per char are small and fixed.
+*
+*/
+
+#ifndef LZ_H
+#define LZ_H
+
+#define LZ_WIN 256		/* history size: match offsets 1..256 */
+#define LZ_HASH 512		/* encoder hash table entries */
+#define LZ_MINMATCH 3
+#define LZ_MAXMATCH (0x7f + LZ_MINMATCH)
+#define LZ_MAXLIT 128		/* longest literal run */
+
+#define LZ_NONE (-1)		/* lz_input/lz_next: no output char yet */
+
+struct lzenc {
+  unsigned char win[2 * LZ_WIN]; /* history, then the chars being coded */
+  int pos;			/* chars in win */
+  short head[LZ_HASH];		/* last win index of each 3-char hash */
+};
+
+struct lzdec {
+  unsigned char hist[LZ_WIN];	/* last LZ_WIN output chars, circular */
+  int hpos;			/* next hist slot */
+  int state;			/* what the next input char is */
+  int count;			/* literals or copy chars left */
+  int back;			/* copy source is hist[hpos + back] */
+};
+
+void lz_enc_init(struct lzenc *e);
+/* compress n chars of buf, passing the compressed chars to put */
+void lz_encode(struct lzenc *e, char *buf, int n,
+	       void (*put)(void *arg, int ch), void *arg);
+
+void lz_dec_init(struct lzdec *d);
+/* feed one compressed char: returns a decoded char or LZ_NONE */
+int lz_input(struct lzdec *d, int ch);
+/* returns the next char of a pending copy, or LZ_NONE; call this
+   until LZ_NONE before feeding more input */
+int lz_next(struct lzdec *d);
+/* how many chars lz_next and lz_input can put out, from what is
+   pending plus the compressed chars get(arg, 0), get(arg, 1)...
+   (LZ_NONE past the last), before they need more input */
+int lz_ready(struct lzdec *d, int (*get)(void *arg, int k), void *arg);
+
+#endif
@@ -0,0 +1,78 @@
+/*********************************************************************
+*
+*       file:           mpsc.c
+*       author:         paul cardoos
+*
+*       multi-producer, single-consumer ring (see mpsc.h)
+*
+*       Position p (a free-running count) lives in slot p & mask.
+*       The slot's seq is p when it is free for the producer of p,
+*       p + 1 once that producer has committed, and p + nslots when
+*       the consumer has released it for the next lap.
+*
+*/
+#include "mpsc.h"
+
+int mpsc_init(struct mpsc *q, char *mem, unsigned int *seq, int size,
+	      int nslots)
+{
+  int i;
+
+  if (size <= 0 || nslots <= 0 || (nslots & (nslots - 1)))
+    return -1;
+  q->mem = mem;
+  q->seq = seq;
+  q->size = size;
+  q->mask = nslots - 1;
+  for (i = 0; i < nslots; i++)
+    seq[i] = i;
+  q->head = q->tail = 0;
+  q->fails = 0;
+  return 0;
+}
+
+void *mpsc_reserve(struct mpsc *q)
+{
+  unsigned int pos;
+  int turn;
+
+  for (;;) {
+    pos = q->head;
+    turn = (int)(q->seq[pos & q->mask] - pos);
+    if (turn == 0) {		/* free: claim it, unless someone beat us */
+      if (__sync_bool_compare_and_swap(&q->head, pos, pos + 1))
+	return q->mem + (pos & q->mask) * q->size;
+    } else if (turn < 0) {	/* last lap's record not consumed yet */
+      __sync_fetch_and_add(&q->fails, 1);
+      return 0;
+    }
+    /* else another producer took pos since we read head: try again */
+  }
+}
+
+void mpsc_commit(struct mpsc *q, void *slot)
+{
+  int i = ((char *)slot - q->mem) / q->size;
+
+  __sync_synchronize();		/* the record before the seq */
+  q->seq[i]++;			/* ours alone until this store */
+}
+
+void *mpsc_peek(struct mpsc *q)
+{
+  unsigned int i = q->tail & q->mask;
+
+  if (q->seq[i] != q->tail + 1)
+    return 0;
+  __sync_synchronize();		/* the seq before the record */
+  return q->mem + i * q->size;
+}
+
+void mpsc_release(struct mpsc *q)
+{
+  unsigned int i = q->tail & q->mask;
+
+  __sync_synchronize();		/* done reading before handing it back */
+  q->seq[i] = q->tail + q->mask + 1;
+  q->tail++;
+}
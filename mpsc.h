@@ -0,0 +1,50 @@
+/*********************************************************************
+*
+*       file:           mpsc.h
+*       author:         paul cardoos
+*
+*       bounded multi-producer, single-consumer ring of fixed-size
+*       records, lock-free like pool.h
+*
+*       Any number of producers--tasks, tty_bh, interrupt handlers,
+*       nested or not--reserve a slot with cmpxchg, fill it in with
+*       interrupts on, and commit it.  Each slot carries a sequence
+*       number that says whose turn it is, so the one consumer sees
+*       records in reservation order, and only once they are
+*       committed.  The consumer never waits for a producer: a slot
+*       still being filled just looks empty for now.
+*
+*/
+
+#ifndef MPSC_H
+#define MPSC_H
+
+struct mpsc {
+  char *mem;			/* nslots records of size bytes */
+  volatile unsigned int *seq;	/* per-slot turn, see mpsc.c */
+  int size;
+  unsigned int mask;		/* nslots - 1 */
+  volatile unsigned int head;	/* next position to reserve */
+  unsigned int tail;		/* next position to consume */
+  volatile unsigned int fails;	/* mpsc_reserve calls with the ring full */
+};
+
+/* define the memory for a ring: name_mem and name_seq */
+#define MPSC_STORAGE(name, size, nslots) \
+  char name##_mem[(size) * (nslots)]; \
+  unsigned int name##_seq[nslots]
+
+/* set up q over caller's memory; nslots must be a power of two;
+   returns 0, or -1 on bad args */
+int mpsc_init(struct mpsc *q, char *mem, unsigned int *seq, int size,
+	      int nslots);
+/* producers: a slot to fill in, or 0 if the ring is full */
+void *mpsc_reserve(struct mpsc *q);
+/* producers: the slot from mpsc_reserve is ready for the consumer */
+void mpsc_commit(struct mpsc *q, void *slot);
+/* consumer: the oldest committed record, or 0 if none */
+void *mpsc_peek(struct mpsc *q);
+/* consumer: done with the record from mpsc_peek */
+void mpsc_release(struct mpsc *q);
+
+#endif
@@ -0,0 +1,205 @@
+/*********************************************************************
+*
+*       file:           mux.c
+*       author:         paul cardoos
+*
+*       mux driver--virtual channels over one tty, with credit-based
+*       flow control per channel (see mux.h for the frame format)
+*
+*       There is no receive interrupt of our own: whichever task
+*       first has to wait for a channel reads frames from the tty
+*       (the "pump") and sorts them into the channels' queues, while
+*       any other waiting tasks sleep until it is done.  Everything
+*       here runs at task level.
+*
+*/
+#include <cpu.h>
+#include "ioconf.h"
+#include "io_public.h"
+#include "mux.h"
+
+struct muxch muxtab[NMUXCH];
+static struct muxlink the_link;
+
+static int attach(void);
+static void wait_link(struct waitq *wq);
+static void pump(void);
+static void send_credit(struct muxch *ch);
+
+/*====================================================================
+*       mux specific initialization routine
+====================================================================*/
+
+void muxinit(int dev)
+{
+  struct muxch *ch = (struct muxch *)devtab[dev].dvdata;
+
+  the_link.tty = devtab[dev].dvbaseport; /* the tty dev number, for us */
+  the_link.attached = 0;		/* framing is turned on at first use */
+  the_link.pumping = 0;
+  ch->chan = ch - muxtab;
+  init_queue(&ch->rxq, MUXBUF);
+  ch->credit = MUXBUF - 1;	/* the other end's rxq starts empty too */
+  ch->consumed = 0;
+  ch->readers.head = ch->readers.tail = 0;
+  ch->writers.head = ch->writers.tail = 0;
+}
+
+/*====================================================================
+*       mux-specific read routine: nchar chars from the channel
+====================================================================*/
+
+int muxread(int dev, char *buf, int nchar)
+{
+  struct muxch *ch = (struct muxch *)devtab[dev].dvdata;
+  int i, c;
+
+  if (attach() < 0)
+    return -1;
+  i = 0;
+  while (i < nchar) {
+    if ((c = dequeue(&ch->rxq)) != EMPTYQUE) {
+      buf[i++] = c;
+      ch->consumed++;
+      continue;
+    }
+    /* hand back what we've read first, or the other end may
+     * be waiting for credit to send what we're waiting for */
+    if (ch->consumed)
+      send_credit(ch);
+    wait_link(&ch->readers);
+  }
+  if (ch->consumed >= MUXBUF / 4)
+    send_credit(ch);
+  return nchar;
+}
+
+/*====================================================================
+*       mux-specific write routine: a frame per MUXDATA or credit
+====================================================================*/
+
+int muxwrite(int dev, char *buf, int nchar)
+{
+  struct muxch *ch = (struct muxch *)devtab[dev].dvdata;
+  char f[FRAMEMAX];
+  int i, j, len;
+
+  if (attach() < 0)
+    return -1;
+  for (i = 0; i < nchar; i += len) {
+    while (ch->credit == 0)
+      wait_link(&ch->writers);
+    len = nchar - i;
+    if (len > ch->credit)
+      len = ch->credit;
+    if (len > MUXDATA)
+      len = MUXDATA;
+    f[0] = 'D';
+    f[1] = ch->chan;
+    for (j = 0; j < len; j++)
+      f[MUXHDR + j] = buf[i + j];
+    write(the_link.tty, f, MUXHDR + len);
+    ch->credit -= len;
+  }
+  return nchar;
+}
+
+/*====================================================================
+*       mux-specific control routine
+====================================================================*/
+
+int muxcontrol(int dev, int fncode, int val)
+{
+  struct muxch *ch = (struct muxch *)devtab[dev].dvdata;
+
+  switch (fncode) {
+  case MUXREADYCONTROL:
+    return queuecount(&ch->rxq);
+  case MUXCREDITCONTROL:
+    return ch->credit;
+  case MUXDETACHCONTROL:
+    if (the_link.attached && !the_link.pumping) {
+      control(the_link.tty, FRAMECONTROL, FRAME_NONE);
+      the_link.attached = 0;
+    }
+    break;
+  default:
+    return -1;
+  }
+  return 0;
+}
+
+/*====================================================================
+*       the link
+====================================================================*/
+
+static int attach(void)
+{
+  if (!the_link.attached) {
+    if (control(the_link.tty, FRAMECONTROL, FRAME_COBS) < 0)
+      return -1;
+    the_link.attached = 1;
+  }
+  return 0;
+}
+
+/* Wait for the pump to deliver something: run it ourselves if no
+ * one else is, else sleep on wq until it wakes us. */
+static void wait_link(struct waitq *wq)
+{
+  int saved_eflags;
+
+  if (!the_link.pumping) {
+    pump();
+    return;
+  }
+  saved_eflags = get_eflags();
+  cli();			/* as task_sleep requires */
+  task_sleep(wq);
+  set_eflags(saved_eflags);
+}
+
+/* read one frame and deliver it, then let every waiting task look
+ * (one of them will take over pumping if it still has to wait) */
+static void pump(void)
+{
+  char f[FRAMEMAX];
+  struct muxch *ch;
+  int len, i, saved_eflags;
+
+  the_link.pumping = 1;
+  len = read(the_link.tty, f, FRAMEMAX);
+  if (len < MUXHDR || (f[1] & 0xff) >= NMUXCH)
+    the_link.badframes++;
+  else {
+    ch = &muxtab[f[1] & 0xff];
+    if (f[0] == 'D') {
+      for (i = MUXHDR; i < len; i++)
+	if (enqueue(&ch->rxq, f[i]) == FULLQUE)
+	  the_link.overruns++;
+    } else if (f[0] == 'C' && len == MUXHDR + 2)
+      ch->credit += (f[2] & 0xff) | (f[3] & 0xff) << 8;
+    else
+      the_link.badframes++;
+  }
+  the_link.pumping = 0;
+  saved_eflags = get_eflags();
+  cli();			/* the ready list is shared with ISRs */
+  for (i = 0; i < NMUXCH; i++) {
+    task_wakeup(&muxtab[i].readers);
+    task_wakeup(&muxtab[i].writers);
+  }
+  set_eflags(saved_eflags);
+}
+
+static void send_credit(struct muxch *ch)
+{
+  char f[MUXHDR + 2];
+
+  f[0] = 'C';
+  f[1] = ch->chan;
+  f[2] = ch->consumed & 0xff;
+  f[3] = ch->consumed >> 8;
+  ch->consumed = 0;
+  write(the_link.tty, f, sizeof(f));
+}
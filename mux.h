@@ -0,0 +1,56 @@
+/*********************************************************************
+*
+*       file:           mux.h
+*       author:         paul cardoos
+*
+*       private header file for the virtual channel mux
+*       apps should not include this header
+*
+*       Each channel's data goes in COBS frames on the tty:
+*         'D', channel, data...
+*         'C', channel, count (2 bytes, little-endian)
+*       A 'C' frame gives the other end credit for count more chars
+*       of that channel, as its reader frees space in rxq, so data
+*       is only sent when there is room for it and a channel nobody
+*       reads never holds up the others.
+*
+*/
+
+#ifndef MUX_H
+#define MUX_H
+
+#include "mux_public.h"
+#include "queue/queue.h"
+#include "task.h"
+
+#define MUXBUF 256		/* rxq size per channel */
+#define MUXHDR 2		/* type, channel */
+#define MUXDATA (FRAMEMAX - MUXHDR) /* most data per frame */
+
+struct muxch {
+  int chan;			/* 0..NMUXCH-1 */
+  Queue rxq;			/* received, waiting for read */
+  int credit;			/* chars the other end has room for */
+  int consumed;			/* chars read, not yet credited back */
+  struct waitq readers;		/* tasks waiting for rxq data */
+  struct waitq writers;		/* tasks waiting for credit */
+};
+
+/* the one link all channels share */
+struct muxlink {
+  int tty;			/* lower device, from devtab */
+  int attached;			/* tty is in framing mode for us */
+  int pumping;			/* a task is reading the tty for all */
+  unsigned int badframes;	/* too short, bad channel or type */
+  unsigned int overruns;	/* data beyond the credit given */
+};
+
+extern struct muxch muxtab[];
+
+/* mux-specific device functions */
+void muxinit(int dev);
+int muxread(int dev, char *buf, int nchar);
+int muxwrite(int dev, char *buf, int nchar);
+int muxcontrol(int dev, int fncode, int val);
+
+#endif
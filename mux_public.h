@@ -0,0 +1,31 @@
+/*********************************************************************
+*
+*       file:           mux_public.h
+*       author:         paul cardoos
+*
+*       virtual channel (mux) defs that applications have need to use
+*
+*       MUX0..MUX3 are independent byte streams carried over one tty
+*       (TTY1, see ioconf.c); the other end must use the mux too.
+*
+*/
+
+#ifndef MUX_PUBLIC_H
+#define MUX_PUBLIC_H
+
+#define NMUXCH 4
+
+/* Device name definitions */
+
+#define	MUX0     3			/* type mux      */
+#define	MUX1     4			/* type mux      */
+#define	MUX2     5			/* type mux      */
+#define	MUX3     6			/* type mux      */
+
+/* control function codes (second arg of control) */
+#define MUXREADYCONTROL 1	/* returns chars read could take now */
+#define MUXCREDITCONTROL 2	/* returns chars write could send now */
+#define MUXDETACHCONTROL 3	/* give the tty back (all channels); the
+				   next mux read or write takes it again */
+
+#endif
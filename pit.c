@@ -0,0 +1,267 @@
+/*********************************************************************
+*
+*       file:           pit.c
+*       author:         paul cardoos
+*
+*       timer driver--8254 PIT channel 0 on IRQ 0, ticking at HZ,
+*       with a TSC-interpolated microsecond clock and timer callbacks
+*
+*/
+#include <stdio.h>  /* for kprintf prototype */
+#include <cpu.h>
+#include <pic.h>
+#include "ioconf.h"
+#include "pit.h"
+#include "tsc.h"
+#include "prof.h"
+#include "tty.h"		/* tty_timer_bh */
+
+struct pit pittab[1];		/* there is one system timer */
+
+#define CAL_MS 50		/* TSC calibration time at init */
+
+static struct pit *the_pit;	/* for the kernel calls below */
+
+/* tell C about the assembler shell routine */
+extern void irq0inthand(void);
+
+/* C part of interrupt handler--specific name called by the assembler code */
+extern void irq0inthandc(void);
+
+static unsigned int calibrate_tsc(void);
+static int load_control(struct pit *pit, struct cpuload *load);
+static void insert_timer(struct pit *pit, struct pit_timer *t);
+
+/*====================================================================
+*       pit specific initialization routine
+====================================================================*/
+
+void pitinit(int dev)
+{
+  struct pit *pit = (struct pit *)devtab[dev].dvdata;
+
+  the_pit = pit;
+  pit->ticks = 0;
+  pit->timers = 0;
+  pit->sleepers.head = pit->sleepers.tail = 0;
+  pit->cpu_hz = calibrate_tsc();
+  pit->cycles_per_tick = pit->cpu_hz / HZ;
+
+  /* arm interrupts by installing int vec */
+  set_intr_gate(PIT_IRQ+IRQ_TO_INT_N_SHIFT, &irq0inthand);
+  pic_enable_irq(PIT_IRQ);
+
+  /* channel 0, lsb then msb, mode 2 (rate generator) */
+  outpt(PIT_CMD, 0x34);
+  outpt(devtab[dev].dvbaseport, PIT_LATCH & 0xff);
+  outpt(devtab[dev].dvbaseport, PIT_LATCH >> 8);
+  pit->tick_tsc = pit->init_tsc = rdtsc();
+  pit_cpu_load(&pit->lastload);
+}
+
+/*====================================================================
+*       the timer has no data stream: read and write fail
+====================================================================*/
+
+int pitread(int dev, char *buf, int nchar)
+{
+  return -1;
+}
+
+int pitwrite(int dev, char *buf, int nchar)
+{
+  return -1;
+}
+
+/*====================================================================
+*       pit-specific control routine
+====================================================================*/
+
+int pitcontrol(int dev, int fncode, int val)
+{
+  switch (fncode) {
+  case TICKCONTROL:
+    return pit_ticks();
+  case CLOCKCONTROL:
+    *(unsigned long long *)val = pit_clock_us();
+    break;
+  case SLEEPCONTROL:
+    pit_sleep(val);
+    break;
+  case TIMERCONTROL:
+    pit_timer_start((struct pit_timer *)val);
+    break;
+  case CANCELCONTROL:
+    pit_timer_stop((struct pit_timer *)val);
+    break;
+  case CPUHZCONTROL:
+    return pit_cpu_hz();
+  case PROFCONTROL:
+    if (val)
+      prof_start();
+    else
+      prof_stop();
+    break;
+  case PROFDUMPCONTROL:
+    prof_dump();
+    break;
+  case LOADCONTROL:
+    return load_control(the_pit, (struct cpuload *)val);
+  default:
+    return -1;
+  }
+  return 0;
+}
+
+/*====================================================================
+*       calls for other drivers
+====================================================================*/
+
+unsigned int pit_ticks(void)
+{
+  return the_pit->ticks;
+}
+
+/* microseconds since init: whole ticks, plus TSC cycles since the
+ * last tick; clamped below one tick so the clock never runs backward */
+unsigned long long pit_clock_us(void)
+{
+  unsigned int ticks, frac;
+  unsigned long long since;
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  ticks = the_pit->ticks;
+  since = rdtsc() - the_pit->tick_tsc;
+  set_eflags(saved_eflags);
+
+  frac = div64_32(since * (1000000 / HZ), the_pit->cycles_per_tick);
+  if (frac >= 1000000 / HZ)
+    frac = 1000000 / HZ - 1;
+  return (unsigned long long)ticks * (1000000 / HZ) + frac;
+}
+
+unsigned int pit_cpu_hz(void)
+{
+  return the_pit->cpu_hz;
+}
+
+void pit_cpu_load(struct cpuload *load)
+{
+  load->cycles = rdtsc() - the_pit->init_tsc;
+  load->idle = cpu_idle_cycles();
+}
+
+/* wait at least n ticks, letting other tasks run */
+void pit_sleep(int n)
+{
+  unsigned int until;
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  until = the_pit->ticks + n;
+  while ((int)(the_pit->ticks - until) < 0)
+    task_sleep(&the_pit->sleepers);
+  set_eflags(saved_eflags);
+}
+
+void pit_timer_start(struct pit_timer *t)
+{
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  t->expires = the_pit->ticks + t->ticks;
+  insert_timer(the_pit, t);
+  set_eflags(saved_eflags);
+}
+
+void pit_timer_stop(struct pit_timer *t)
+{
+  struct pit_timer **p;
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  for (p = &the_pit->timers; *p; p = &(*p)->next)
+    if (*p == t) {
+      *p = t->next;
+      break;
+    }
+  set_eflags(saved_eflags);
+}
+
+/* keep the list soonest first, so the ISR only looks at the head */
+static void insert_timer(struct pit *pit, struct pit_timer *t)
+{
+  struct pit_timer **p;
+
+  for (p = &pit->timers; *p; p = &(*p)->next)
+    if ((int)((*p)->expires - t->expires) > 0)
+      break;
+  t->next = *p;
+  *p = t;
+}
+
+/*====================================================================
+*       timer interrupt routine
+====================================================================*/
+
+void irq0inthandc(void)
+{
+  struct pit *pit = the_pit;
+  struct pit_timer *t;
+
+  cpu_wake();			/* the rest is busy time */
+  pic_end_int();                /* notify PIC that its part is done */
+  pit->tick_tsc = rdtsc();
+  pit->ticks++;
+  task_wakeup(&pit->sleepers);	/* they check their own deadlines */
+
+  while ((t = pit->timers) && (int)(t->expires - pit->ticks) <= 0) {
+    pit->timers = t->next;
+    if (t->period) {		/* re-arm before the call, which may stop it */
+      t->expires += t->period;
+      insert_timer(pit, t);
+    }
+    t->fn(t->arg);
+  }
+  /* last: it turns ints on, and the timer list is done with */
+  tty_timer_bh();
+}
+
+/* busy share since last time, in tenths of a percent */
+static int load_control(struct pit *pit, struct cpuload *load)
+{
+  struct cpuload now;
+  unsigned long long cycles, idle;
+
+  pit_cpu_load(&now);
+  cycles = now.cycles - pit->lastload.cycles;
+  idle = now.idle - pit->lastload.idle;
+  pit->lastload = now;
+  if (load)
+    *load = now;
+  if (cycles >> 8 == 0)
+    return 0;
+  return 1000 - div64_32((idle >> 8) * 1000, cycles >> 8);
+}
+
+/* count TSC cycles over CAL_MS of PIT channel 2 (the speaker timer) */
+static unsigned int calibrate_tsc(void)
+{
+  unsigned long long t0, t1;
+  int latch = PIT_INPUT_HZ / (1000 / CAL_MS);
+
+  outpt(PIT_GATE, (inpt(PIT_GATE) & ~0x02) | 0x01); /* gate on, no sound */
+  outpt(PIT_CMD, 0xb0);		/* ch 2, lsb then msb, mode 0 */
+  outpt(PIT_CH2, latch & 0xff);
+  outpt(PIT_CH2, latch >> 8);
+  t0 = rdtsc();
+  while ((inpt(PIT_GATE) & 0x20) == 0) /* out goes high at count 0 */
+    ;
+  t1 = rdtsc();
+  return div64_32((t1 - t0) * 1000, CAL_MS);
+}
@@ -0,0 +1,54 @@
+/*********************************************************************
+*
+*       file:           pit.h
+*       author:         paul cardoos
+*
+*       private header file for the PIT timer driver
+*       apps should not include this header
+*
+*/
+
+#ifndef PIT_H
+#define PIT_H
+
+#include "pit_public.h"
+#include "task.h"
+
+/* 8254 i/o ports and command bits */
+#define PIT_IRQ 0
+#define PIT_CH0 0x40
+#define PIT_CH2 0x42
+#define PIT_CMD 0x43
+#define PIT_GATE 0x61		/* speaker port: bit 0 ch 2 gate, bit 5 out */
+#define PIT_INPUT_HZ 1193182	/* counter input clock */
+#define PIT_LATCH ((PIT_INPUT_HZ + HZ/2) / HZ)
+
+struct pit {
+  volatile unsigned int ticks;	/* ticks since init */
+  unsigned long long tick_tsc;	/* TSC at the latest tick */
+  unsigned int cpu_hz;		/* TSC cycles per second */
+  unsigned int cycles_per_tick;
+  struct pit_timer *timers;	/* pending, soonest first */
+  struct waitq sleepers;	/* tasks in pit_sleep, woken every tick */
+  unsigned long long init_tsc;	/* TSC at init, for LOADCONTROL */
+  struct cpuload lastload;	/* at the previous LOADCONTROL */
+};
+
+extern struct pit pittab[];
+
+/* pit-specific device functions */
+void pitinit(int dev);
+int pitread(int dev, char *buf, int nchar);
+int pitwrite(int dev, char *buf, int nchar);
+int pitcontrol(int dev, int fncode, int val);
+
+/* for other drivers: the one system timer */
+unsigned int pit_ticks(void);
+unsigned long long pit_clock_us(void);
+unsigned int pit_cpu_hz(void);
+void pit_cpu_load(struct cpuload *load);
+void pit_sleep(int ticks);
+void pit_timer_start(struct pit_timer *t);
+void pit_timer_stop(struct pit_timer *t);
+
+#endif
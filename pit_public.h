@@ -0,0 +1,54 @@
+/*********************************************************************
+*
+*       file:           pit_public.h
+*       author:         paul cardoos
+*
+*       timer (8254 PIT) defs that applications have need to use
+*
+*/
+
+#ifndef PIT_PUBLIC_H
+#define PIT_PUBLIC_H
+
+/* Device name definitions */
+
+#define	PIT0     2			/* type pit      */
+
+#define HZ 1000				/* clock ticks per second */
+
+/* control function codes (second arg of control) */
+#define TICKCONTROL 1		/* returns ticks since ioinit */
+#define CLOCKCONTROL 2		/* val: unsigned long long * to fill in
+				   with microseconds since ioinit */
+#define SLEEPCONTROL 3		/* val: ticks to wait */
+#define TIMERCONTROL 4		/* val: struct pit_timer * to start */
+#define CANCELCONTROL 5		/* val: struct pit_timer * to stop */
+#define CPUHZCONTROL 6		/* returns TSC cycles per second */
+#define PROFCONTROL 7		/* val: 1 = start sampling EIP each tick
+				   (discarding old samples), 0 = stop */
+#define PROFDUMPCONTROL 8	/* stop, and kprintf the samples for
+				   profsym (see prof.c) */
+#define LOADCONTROL 9		/* val: struct cpuload * to fill in, or 0;
+				   returns the busy share since the previous
+				   LOADCONTROL, in tenths of a percent */
+
+/* CPU time since ioinit, in TSC cycles: an app can take the
+ * difference of two of these to get the load over its own interval */
+struct cpuload {
+  unsigned long long cycles;	/* all cycles */
+  unsigned long long idle;	/* halted with nothing to run */
+};
+
+/* a timer callback: fn(arg) runs at interrupt level after expires
+ * ticks (set ticks and period, the driver fills in the rest), then
+ * every period ticks if period is not 0 */
+struct pit_timer {
+  int ticks;			/* ticks from now to first call */
+  int period;			/* ticks between later calls, or 0 */
+  void (*fn)(void *arg);
+  void *arg;
+  unsigned int expires;		/* driver: tick count to fire at */
+  struct pit_timer *next;	/* driver: list of pending timers */
+};
+
+#endif
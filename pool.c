@@ -0,0 +1,71 @@
+/*********************************************************************
+*
+*       file:           pool.c
+*       author:         paul cardoos
+*
+*       fixed-size buffer pool allocator, lock-free (see pool.h)
+*
+*/
+#include "pool.h"
+
+#define INDEX(h) ((int)(unsigned int)(h))
+#define NEWHEAD(old, i) \
+  ((((old) >> 32) + 1) << 32 | (unsigned int)(i))
+
+int pool_init(struct pool *p, char *mem, int *links, int bufsize, int nbufs)
+{
+  int i;
+
+  if (bufsize <= 0 || nbufs <= 0)
+    return -1;
+  p->mem = mem;
+  p->links = links;
+  p->bufsize = bufsize;
+  p->nbufs = nbufs;
+  for (i = 0; i < nbufs - 1; i++)
+    links[i] = i + 1;
+  links[nbufs - 1] = POOL_NONE;
+  p->head = 0;			/* count 0, buffer 0 first */
+  p->inuse = p->highwater = 0;
+  p->allocs = p->fails = 0;
+  return 0;
+}
+
+void *pool_alloc(struct pool *p)
+{
+  unsigned long long old;
+  int i, used, high;
+
+  do {
+    old = p->head;		/* may tear on i386: then the swap fails */
+    i = INDEX(old);
+    if (i == POOL_NONE) {
+      __sync_fetch_and_add(&p->fails, 1);
+      return 0;
+    }
+  } while (!__sync_bool_compare_and_swap(&p->head, old,
+					 NEWHEAD(old, p->links[i])));
+
+  __sync_fetch_and_add(&p->allocs, 1);
+  used = __sync_add_and_fetch(&p->inuse, 1);
+  while (used > (high = p->highwater) &&
+	 !__sync_bool_compare_and_swap(&p->highwater, high, used))
+    ;
+  return p->mem + i * p->bufsize;
+}
+
+int pool_free(struct pool *p, void *buf)
+{
+  unsigned long long old;
+  int off = (char *)buf - p->mem;
+  int i = off / p->bufsize;
+
+  if (off < 0 || i >= p->nbufs || off != i * p->bufsize)
+    return -1;			/* not one of ours */
+  do {
+    old = p->head;
+    p->links[i] = INDEX(old);
+  } while (!__sync_bool_compare_and_swap(&p->head, old, NEWHEAD(old, i)));
+  __sync_fetch_and_sub(&p->inuse, 1);
+  return 0;
+}
@@ -0,0 +1,45 @@
+/*********************************************************************
+*
+*       file:           pool.h
+*       author:         paul cardoos
+*
+*       fixed-size buffer pools for i/o buffers
+*
+*       pool_alloc and pool_free are O(1) and lock-free, so they can
+*       be called from interrupt handlers and tasks alike without
+*       cli(): the free list head is swapped with cmpxchg8b, tagged
+*       with a change count so an ISR's pop and push between our
+*       read and our swap can't fool us (the ABA problem).
+*
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#define POOL_NONE (-1)		/* end of free list */
+
+struct pool {
+  char *mem;			/* nbufs buffers of bufsize bytes */
+  int *links;			/* links[i]: free buffer after buffer i */
+  int bufsize;
+  int nbufs;
+  volatile unsigned long long head; /* change count << 32 | first free */
+  volatile int inuse;		/* buffers now allocated */
+  volatile int highwater;	/* most ever allocated at once */
+  volatile unsigned int allocs;	/* successful pool_alloc calls */
+  volatile unsigned int fails;	/* pool_alloc calls with pool empty */
+};
+
+/* define the memory for a pool: name_mem and name_links */
+#define POOL_STORAGE(name, bufsize, nbufs) \
+  char name##_mem[(bufsize) * (nbufs)]; \
+  int name##_links[nbufs]
+
+/* set up pool p over caller's memory; returns 0, or -1 on bad args */
+int pool_init(struct pool *p, char *mem, int *links, int bufsize, int nbufs);
+/* returns a buffer, or 0 if all are in use */
+void *pool_alloc(struct pool *p);
+/* give back a buffer from pool_alloc; returns -1 if it isn't p's */
+int pool_free(struct pool *p, void *buf);
+
+#endif
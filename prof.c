@@ -0,0 +1,86 @@
+/*********************************************************************
+*
+*       file:           prof.c
+*       author:         paul cardoos
+*
+*       statistical EIP profiler on the PIT tick
+*
+*       prof_start points the IRQ 0 vector at irq0profhand
+*       (profirq.s), which records the interrupted EIP here and
+*       then does the timer's usual work; prof_stop puts back the
+*       library's irq0inthand.  prof_dump prints the samples as
+*
+*       prof,version,1,samples,<n>,lost,<n>
+*       prof <eip in hex> <count>
+*       ...
+*
+*       Run "grep ^prof" on the transcript into a file and give it
+*       to profsym along with the program's .syms file.
+*
+*/
+#include <stdio.h>  /* for kprintf prototype */
+#include <cpu.h>
+#include <pic.h>
+#include "pit.h"
+#include "prof.h"
+
+static unsigned int samples[PROFBUF];
+static unsigned int nsamples;	/* taken since prof_start, may be > PROFBUF */
+
+/* the assembler envelopes */
+extern void irq0inthand(void), irq0profhand(void);
+
+/* C part of our envelope */
+extern void irq0profhandc(unsigned int *frame);
+/* the timer's own C handler, in pit.c */
+extern void irq0inthandc(void);
+
+void prof_start(void)
+{
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  nsamples = 0;
+  set_intr_gate(PIT_IRQ+IRQ_TO_INT_N_SHIFT, &irq0profhand);
+  set_eflags(saved_eflags);
+}
+
+void prof_stop(void)
+{
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  set_intr_gate(PIT_IRQ+IRQ_TO_INT_N_SHIFT, &irq0inthand);
+  set_eflags(saved_eflags);
+}
+
+/* Sort the samples in place (insertion sort: no qsort in the SAPC
+ * library, and this is after the measurement) and print each EIP
+ * once, with how many times it was seen. */
+void prof_dump(void)
+{
+  unsigned int n, i, j, eip, count;
+
+  prof_stop();
+  n = nsamples < PROFBUF ? nsamples : PROFBUF;
+  for (i = 1; i < n; i++) {
+    eip = samples[i];
+    for (j = i; j > 0 && samples[j - 1] > eip; j--)
+      samples[j] = samples[j - 1];
+    samples[j] = eip;
+  }
+  kprintf("prof,version,1,samples,%u,lost,%u\n", n, nsamples - n);
+  for (i = 0; i < n; i += count) {
+    for (count = 1; i + count < n && samples[i + count] == samples[i]; count++)
+      ;
+    kprintf("prof %08x %d\n", samples[i], count);
+  }
+}
+
+void irq0profhandc(unsigned int *frame)
+{
+  samples[nsamples++ % PROFBUF] = frame[0];
+  irq0inthandc();
+}
@@ -0,0 +1,24 @@
+/*********************************************************************
+*
+*       file:           prof.h
+*       author:         paul cardoos
+*
+*       statistical profiler: while on, every PIT tick records the
+*       EIP it interrupted, for profsym to resolve against the .syms
+*       file; apps use it through PROFCONTROL/PROFDUMPCONTROL on PIT0
+*
+*/
+
+#ifndef PROF_H
+#define PROF_H
+
+#define PROFBUF 4096		/* samples kept, the latest when it wraps */
+
+/* start sampling (from scratch) on the next tick */
+void prof_start(void);
+/* stop sampling */
+void prof_stop(void);
+/* stop, then kprintf "prof <eip> <count>" for each EIP sampled */
+void prof_dump(void);
+
+#endif
@@ -0,0 +1,19 @@
+# file:   profirq.s
+# author: paul cardoos
+#
+# IRQ 0 envelope for the profiler: like the library's irq0inthand,
+# but passes the C handler a pointer to the interrupt frame, so it
+# can see the EIP that was interrupted.
+#
+# void irq0profhandc(unsigned int *frame)   frame[0] = eip
+
+	.text
+	.globl irq0profhand
+irq0profhand:
+	pushal
+	leal 32(%esp), %eax	# past the 8 registers pushal saved
+	pushl %eax
+	call irq0profhandc
+	addl $4, %esp
+	popal
+	iret
@@ -0,0 +1,129 @@
+/*
+ * program : profsym.c
+ * by      : paul cardoos
+ * purpose : flat per-function profile from the SAPC profiler
+ *
+ * usage: profsym testio.syms prof.txt
+ *
+ * prof.txt is the "prof <eip> <count>" lines prof_dump printed
+ * ("grep ^prof" on the transcript; other lines are ignored).  Each
+ * EIP is charged to the nearest symbol at or below it in the .syms
+ * file (nm -n output), and the functions are printed busiest first:
+ *
+ *   percent  samples  function
+ *
+ * This is a UNIX host program: make profsym.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXSYMS 4096
+#define NAMELEN 64
+
+struct sym {
+  unsigned int addr;
+  char name[NAMELEN];
+  unsigned int samples;
+};
+
+static struct sym syms[MAXSYMS];
+static int nsyms;
+
+static int read_syms(char *file);
+static struct sym *lookup(unsigned int eip);
+static int by_samples(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+  FILE *fp;
+  char line[256];
+  unsigned int eip, count, total = 0, unknown = 0;
+  struct sym *s;
+  int i;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: profsym file.syms prof.txt\n");
+    return 1;
+  }
+  if (read_syms(argv[1]) < 0)
+    return 1;
+  if ((fp = fopen(argv[2], "r")) == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  while (fgets(line, sizeof(line), fp))
+    if (sscanf(line, "prof %x %u", &eip, &count) == 2) {
+      total += count;
+      if ((s = lookup(eip)) != NULL)
+	s->samples += count;
+      else
+	unknown += count;
+    }
+  fclose(fp);
+  if (total == 0) {
+    fprintf(stderr, "%s: no prof lines\n", argv[2]);
+    return 1;
+  }
+
+  qsort(syms, nsyms, sizeof(syms[0]), by_samples);
+  printf("%7s %8s  %s\n", "percent", "samples", "function");
+  for (i = 0; i < nsyms && syms[i].samples; i++)
+    printf("%7.2f %8u  %s\n", 100.0 * syms[i].samples / total,
+	   syms[i].samples, syms[i].name);
+  if (unknown)
+    printf("%7.2f %8u  %s\n", 100.0 * unknown / total, unknown, "(unknown)");
+  printf("%7s %8u  total\n", "", total);
+  return 0;
+}
+
+/* text symbols only, in address order as nm -n gives them */
+static int read_syms(char *file)
+{
+  FILE *fp;
+  char line[256], type, name[NAMELEN];
+  unsigned int addr;
+
+  if ((fp = fopen(file, "r")) == NULL) {
+    perror(file);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) && nsyms < MAXSYMS)
+    if (sscanf(line, "%x %c %63s", &addr, &type, name) == 3 &&
+	(type == 'T' || type == 't')) {
+      if (nsyms && syms[nsyms - 1].addr == addr)
+	continue;		/* an alias: keep the first name */
+      syms[nsyms].addr = addr;
+      strcpy(syms[nsyms].name, name);
+      nsyms++;
+    }
+  fclose(fp);
+  return 0;
+}
+
+/* last symbol at or below eip, by binary search */
+static struct sym *lookup(unsigned int eip)
+{
+  int lo = 0, hi = nsyms - 1, mid;
+
+  if (nsyms == 0 || eip < syms[0].addr)
+    return NULL;
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (syms[mid].addr <= eip)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return &syms[lo];
+}
+
+static int by_samples(const void *a, const void *b)
+{
+  const struct sym *x = a, *y = b;
+
+  if (x->samples != y->samples)
+    return x->samples < y->samples ? 1 : -1;
+  return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
@@ -0,0 +1,272 @@
+/*
+ * program : benchqueue.c
+ * by      : paul cardoos (from testqueue.c)
+ * date    : Mar. 2021
+ * purpose : cycle counts for the queue package operations
+ *
+ * Times enqueue, dequeue, queuecount and emptyqueue with rdtsc at
+ * several capacities, fill levels and wrap positions, and the same
+ * enqueue/dequeue on two alternative rings, to see what the modulo
+ * in addone() costs:
+ *   "queue"  queue.c itself, (i + 1) % max
+ *   "cmp"    same ring, wraps with a compare: if (++i == max) i = 0
+ *   "mask"   power-of-two array, wraps with (i + 1) & mask
+ *
+ * Builds for SAPC (make benchqueue.lnx) or native on Linux
+ * (make benchqueue).  Output is CSV lines starting with "qbench,":
+ *   qbench,impl,op,capacity,fill,wrap,avg_cycles,min_cycles
+ * with the cost of an empty rdtsc pair already subtracted.
+ */
+
+#include <stdio.h>
+#include "queue.h"
+#include "../tsc.h"
+
+#define NITER 1000		/* timed calls per measurement */
+#define RINGBUF 128		/* power of two, >= the largest cap */
+
+#define NOINLINE __attribute__((noinline)) /* keep -O2 fair to queue.c */
+
+/* the alternative ring designs: count-based, head/tail indices */
+typedef struct ring {
+  char ch[RINGBUF];
+  int head;			/* next char to take */
+  int tail;			/* next free slot */
+  int count;
+  int size;			/* array entries used */
+  int mask;			/* size - 1, for "mask" */
+} Ring;
+
+NOINLINE int cmp_enqueue(Ring *r, char ch);
+NOINLINE int cmp_dequeue(Ring *r);
+NOINLINE int mask_enqueue(Ring *r, char ch);
+NOINLINE int mask_dequeue(Ring *r);
+
+static int caps[] = {6, 15, 31, 63, 99};
+#define NCAPS (sizeof(caps)/sizeof(caps[0]))
+
+static unsigned int overhead;	/* cycles for back-to-back rdtsc */
+
+static void calibrate(void);
+static void bench_queue(int cap, int fill, int wrap);
+static void bench_ring(char *impl, int cap, int fill, int wrap);
+static void report(char *impl, char *op, int cap, int fill, int wrap,
+		   unsigned long long total, unsigned int min);
+
+Queue qobj;
+Ring robj;
+
+int main()
+{
+  unsigned int i;
+  int cap, f, fills[3], wrap;
+
+  calibrate();
+  printf("qbench,impl,op,capacity,fill,wrap,avg_cycles,min_cycles\n");
+  for (i = 0; i < NCAPS; i++) {
+    cap = caps[i];
+    /* fill level: empty, half full, one short of full */
+    fills[0] = 0;
+    fills[1] = cap / 2;
+    fills[2] = cap - 1;
+    for (f = 0; f < 3; f++)
+      /* wrap 0: data starts at the array front; 1: data straddles the end */
+      for (wrap = 0; wrap <= 1; wrap++) {
+	bench_queue(cap, fills[f], wrap);
+	bench_ring("cmp", cap, fills[f], wrap);
+	bench_ring("mask", cap, fills[f], wrap);
+      }
+  }
+  return 0;
+}
+
+static void calibrate(void)
+{
+  unsigned long long t0, t1;
+  int i;
+
+  overhead = 0xffffffff;
+  for (i = 0; i < NITER; i++) {
+    t0 = rdtsc();
+    t1 = rdtsc();
+    if ((unsigned int)(t1 - t0) < overhead)
+      overhead = t1 - t0;
+  }
+}
+
+/* timed cycles for one call, less the rdtsc cost */
+static unsigned int elapsed(unsigned long long t0, unsigned long long t1)
+{
+  unsigned int d = t1 - t0;
+
+  return d > overhead ? d - overhead : 0;
+}
+
+/* set up q at capacity cap holding fill chars, straddling the end if wrap */
+static void setup_queue(Queue *q, int cap, int fill, int wrap)
+{
+  int i, start;
+
+  init_queue(q, cap);
+  start = wrap ? q->max - 1 - fill / 2 : 0;
+  for (i = 0; i < start; i++) {	/* walk front/rear along the array */
+    enqueue(q, 'x');
+    dequeue(q);
+  }
+  for (i = 0; i < fill; i++)
+    enqueue(q, 'a' + i % 26);
+}
+
+static void bench_queue(int cap, int fill, int wrap)
+{
+  Queue *q = &qobj;
+  unsigned long long t0, t1, t2, enq = 0, deq = 0, cnt = 0, emp = 0;
+  unsigned int d, enqmin = 0xffffffff, deqmin = 0xffffffff;
+  unsigned int cntmin = 0xffffffff, empmin = 0xffffffff;
+  int i;
+
+  setup_queue(q, cap, fill, wrap);
+  for (i = 0; i < NITER; i++) {
+    /* a pair keeps the fill level steady, and walks around the ring */
+    t0 = rdtsc();
+    enqueue(q, 'z');
+    t1 = rdtsc();
+    dequeue(q);
+    t2 = rdtsc();
+    d = elapsed(t0, t1);
+    enq += d;
+    if (d < enqmin) enqmin = d;
+    d = elapsed(t1, t2);
+    deq += d;
+    if (d < deqmin) deqmin = d;
+
+    t0 = rdtsc();
+    queuecount(q);
+    t1 = rdtsc();
+    emptyqueue(q);
+    t2 = rdtsc();
+    d = elapsed(t0, t1);
+    cnt += d;
+    if (d < cntmin) cntmin = d;
+    d = elapsed(t1, t2);
+    emp += d;
+    if (d < empmin) empmin = d;
+  }
+  report("queue", "enqueue", cap, fill, wrap, enq, enqmin);
+  report("queue", "dequeue", cap, fill, wrap, deq, deqmin);
+  report("queue", "queuecount", cap, fill, wrap, cnt, cntmin);
+  report("queue", "emptyqueue", cap, fill, wrap, emp, empmin);
+}
+
+static void setup_ring(Ring *r, int mask, int cap, int fill, int wrap)
+{
+  int i, start;
+
+  r->head = r->tail = r->count = 0;
+  if (mask) {
+    for (r->size = 1; r->size < cap; r->size <<= 1)
+      ;
+    r->mask = r->size - 1;
+  } else {
+    r->size = cap;
+    r->mask = 0;
+  }
+  start = wrap ? r->size - fill / 2 : 0;
+  r->head = r->tail = start % r->size;
+  for (i = 0; i < fill; i++) {
+    r->ch[r->tail] = 'a' + i % 26;
+    r->tail = (r->tail + 1) % r->size;
+    r->count++;
+  }
+}
+
+static void bench_ring(char *impl, int cap, int fill, int wrap)
+{
+  Ring *r = &robj;
+  int mask = impl[0] == 'm';
+  unsigned long long t0, t1, t2, enq = 0, deq = 0;
+  unsigned int d, enqmin = 0xffffffff, deqmin = 0xffffffff;
+  int i;
+
+  setup_ring(r, mask, cap, fill, wrap);
+  for (i = 0; i < NITER; i++) {
+    if (mask) {
+      t0 = rdtsc();
+      mask_enqueue(r, 'z');
+      t1 = rdtsc();
+      mask_dequeue(r);
+      t2 = rdtsc();
+    } else {
+      t0 = rdtsc();
+      cmp_enqueue(r, 'z');
+      t1 = rdtsc();
+      cmp_dequeue(r);
+      t2 = rdtsc();
+    }
+    d = elapsed(t0, t1);
+    enq += d;
+    if (d < enqmin) enqmin = d;
+    d = elapsed(t1, t2);
+    deq += d;
+    if (d < deqmin) deqmin = d;
+  }
+  report(impl, "enqueue", cap, fill, wrap, enq, enqmin);
+  report(impl, "dequeue", cap, fill, wrap, deq, deqmin);
+}
+
+static void report(char *impl, char *op, int cap, int fill, int wrap,
+		   unsigned long long total, unsigned int min)
+{
+  printf("qbench,%s,%s,%d,%d,%d,%u,%u\n", impl, op, cap, fill, wrap,
+	 div64_32(total, NITER), min);
+}
+
+/* ------------------------------------------------------------------------ */
+/* compare-and-reset wrap */
+int cmp_enqueue(Ring *r, char ch)
+{
+  if (r->count == r->size)
+    return FULLQUE;
+  r->ch[r->tail] = ch;
+  if (++r->tail == r->size)
+    r->tail = 0;
+  r->count++;
+  return ch;
+}
+
+int cmp_dequeue(Ring *r)
+{
+  char ch;
+
+  if (r->count == 0)
+    return EMPTYQUE;
+  ch = r->ch[r->head];
+  if (++r->head == r->size)
+    r->head = 0;
+  r->count--;
+  return ch;
+}
+
+/* ------------------------------------------------------------------------ */
+/* power-of-two mask wrap */
+int mask_enqueue(Ring *r, char ch)
+{
+  if (r->count == r->size)
+    return FULLQUE;
+  r->ch[r->tail] = ch;
+  r->tail = (r->tail + 1) & r->mask;
+  r->count++;
+  return ch;
+}
+
+int mask_dequeue(Ring *r)
+{
+  char ch;
+
+  if (r->count == 0)
+    return EMPTYQUE;
+  ch = r->ch[r->head];
+  r->head = (r->head + 1) & r->mask;
+  r->count--;
+  return ch;
+}
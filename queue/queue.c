@@ -10,6 +10,9 @@
 #include "queue.h"                        
 
 static int addone(Queue *queue, int i);        /* auxiliary function */     
+static void rose(Queue *queue);
+static void fell(Queue *queue);
+static int scan(char *p, int n, int ch);
 
 /* ------------------------------------------------------------------------ */
 /* algorithm from "Data structure and algorithm" - AHU  p62 */
@@ -19,6 +22,12 @@ static int addone(Queue *queue, int i);        /* auxiliary function */
 
 /* note: caller is responsible for having allocated space for queue */
 int init_queue(Queue *queue, int max_chars)
+{
+  return init_queue_mode(queue, max_chars, QUEUE_REJECT);
+}
+
+/* ------------------------------------------------------------------------ */
+int init_queue_mode(Queue *queue, int max_chars, int mode)
 {
   int maxlength = max_chars + 1 ;         /* waste a byte every time */
 
@@ -35,6 +44,10 @@ int init_queue(Queue *queue, int max_chars)
     queue->rear = 0;
     queue->count = 0;
     queue->max = maxlength;	/* actually use maxlength memory */
+    queue->mode = mode;
+    queue->overwritten = 0;
+    queue->wmfn = 0;
+    queue->above = FALSE;
     return TRUE;
   }
 }
@@ -54,14 +67,19 @@ int emptyqueue(Queue *queue)
 /* algorithm from "Data structure and algorithm" - AHU  p62 */
 int enqueue(Queue *queue, char ch)
 {
-  if (addone(queue,addone(queue,queue->rear)) == queue->front)
-    return FULLQUE;
-  else {
-    queue->rear = addone(queue,queue->rear);
-    queue->ch[queue->rear] = ch;
-    queue->count++;
-    return ch;           /* successful */
+  if (addone(queue,addone(queue,queue->rear)) == queue->front) {
+    if (queue->mode != QUEUE_OVERWRITE)
+      return FULLQUE;
+    queue->front = addone(queue,queue->front); /* lose the oldest */
+    queue->count--;
+    queue->overwritten++;
   }
+  queue->rear = addone(queue,queue->rear);
+  queue->ch[queue->rear] = ch;
+  queue->count++;
+  if (queue->wmfn && !queue->above)
+    rose(queue);
+  return ch & 0xff;    /* successful: never FULLQUE, even for 0xff */
 }
 
 /* ------------------------------------------------------------------------ */
@@ -77,7 +95,9 @@ int dequeue(Queue *queue)
     ch = queue->ch[queue->front];
     queue->front = addone(queue,queue->front);
     (queue->count) --;
-    return ch;
+    if (queue->above)
+      fell(queue);
+    return ch & 0xff;    /* 0..255, so never mistaken for EMPTYQUE */
   }
 }
 
@@ -87,6 +107,116 @@ int queuecount(Queue *queue)
   return queue->count;
 }
 
+/* ------------------------------------------------------------------------ */
+int queuepeek(Queue *queue, int k)
+{
+  if (k < 0 || k >= queue->count)
+    return EMPTYQUE;
+  return queue->ch[(queue->front + k) % queue->max] & 0xff;
+}
+
+/* ------------------------------------------------------------------------ */
+/* the chars run from front up to the end of the array, or fewer */
+int queuespan(Queue *queue, char **p)
+{
+  *p = &queue->ch[queue->front];
+  if (queue->front + queue->count <= queue->max)
+    return queue->count;
+  else
+    return queue->max - queue->front;
+}
+
+/* ------------------------------------------------------------------------ */
+int queueskip(Queue *queue, int n)
+{
+  if (n > queue->count)
+    n = queue->count;
+  if (n > 0) {
+    queue->front = (queue->front + n) % queue->max;
+    queue->count -= n;
+    if (queue->above)
+      fell(queue);
+  }
+  return n;
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* the queued chars are at most two runs in ch[]: front to the end of
+   the array, then the start of it */
+int queuefind(Queue *queue, int ch, int n)
+{
+  int first, i;
+
+  if (n > queue->count)
+    n = queue->count;
+  first = queue->max - queue->front;
+  if (first > n)
+    first = n;
+  if ((i = scan(&queue->ch[queue->front], first, ch)) >= 0)
+    return i + 1;
+  if ((i = scan(queue->ch, n - first, ch)) >= 0)
+    return first + i + 1;
+  return 0;
+}
+
+/* index of ch in p[0..n-1], or -1: a word at a time once aligned,
+   using the carry out of each byte of (w ^ ch...) - 0x01... to spot
+   a zero byte, i.e. a match, in 4 at once.  The word is put together
+   from its bytes, not loaded through an (unsigned int *), which the
+   compiler may assume never points into a char array; gcc -O turns
+   it back into one load */
+static int scan(char *p, int n, int ch)
+{
+  unsigned int pat, w;
+  unsigned char *b;
+  int i;
+
+  ch &= 0xff;
+  for (i = 0; i < n && ((unsigned long)(p + i) & 3); i++)
+    if ((p[i] & 0xff) == ch)
+      return i;
+  pat = ch * 0x01010101u;
+  for (; i + 4 <= n; i += 4) {
+    b = (unsigned char *)p + i;
+    w = (b[0] | b[1] << 8 | b[2] << 16 | (unsigned int)b[3] << 24) ^ pat;
+    if ((w - 0x01010101u) & ~w & 0x80808080u)
+      break;			/* one of these 4: find which below */
+  }
+  for (; i < n; i++)
+    if ((p[i] & 0xff) == ch)
+      return i;
+  return -1;
+}
+
+/* ------------------------------------------------------------------------ */
+void queue_watermarks(Queue *queue, int high, int low,
+		      void (*fn)(Queue *q, int which, void *arg), void *arg)
+{
+  queue->high = high;
+  queue->low = low;
+  queue->wmarg = arg;
+  queue->above = fn && queue->count >= high; /* no call for where it is */
+  queue->wmfn = fn;
+}
+
+/* the checks in enqueue/dequeue are just on wmfn/above, so a queue
+   without watermarks pays one test per char */
+static void rose(Queue *queue)
+{
+  if (queue->count >= queue->high) {
+    queue->above = TRUE;
+    queue->wmfn(queue, QUEUE_HIGH, queue->wmarg);
+  }
+}
+
+static void fell(Queue *queue)
+{
+  if (queue->count <= queue->low) {
+    queue->above = FALSE;
+    queue->wmfn(queue, QUEUE_LOW, queue->wmarg);
+  }
+}
 
 /* ------------------------------------------------------------------------ */
 /* algorithm from "Data structure and algorithm" - AHU  p62 */
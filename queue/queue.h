@@ -20,7 +20,15 @@
 #define EMPTYQUE (-1)            /* if queue is empty */
 #define FULLQUE  (-1)            /* if queue is full */
 
-#define MAXCHARBUF 100         /* maximum char size of total char */
+#define MAXCHARBUF 1024        /* maximum char size of total char */
+
+/* what enqueue does when the queue is full */
+#define QUEUE_REJECT 0           /* return FULLQUE, keep the old chars */
+#define QUEUE_OVERWRITE 1        /* drop the oldest char to make room */
+
+/* which way a watermark was crossed, for the queue_watermarks fn */
+#define QUEUE_LOW 0              /* count fell to low */
+#define QUEUE_HIGH 1             /* count rose to high */
 
 typedef struct queue {      
   char ch[MAXCHARBUF];         /* char contain in queue */
@@ -28,6 +36,12 @@ typedef struct queue {
   int rear;                    /* rear index of queue */
   int count;                   /* current numbers of element in queue */ 
   int max;                     /* actually use length */
+  int mode;                    /* QUEUE_REJECT or QUEUE_OVERWRITE */
+  unsigned int overwritten;    /* chars dropped to make room */
+  int high, low;               /* watermarks, if wmfn */
+  int above;                   /* reached high, not yet back to low */
+  void (*wmfn)(struct queue *q, int which, void *arg);
+  void *wmarg;
 } Queue;
 
 
@@ -37,16 +51,48 @@ typedef struct queue {
 
 extern int init_queue(Queue *q, int max_chars);
 
-/* add char ch to the specified queue--returns FULLQUE if q full */
+/* same, with mode QUEUE_REJECT or QUEUE_OVERWRITE (init_queue gives
+   QUEUE_REJECT)-- */
+extern int init_queue_mode(Queue *q, int max_chars, int mode);
+
+/* add char ch to the specified queue--returns FULLQUE if q full,
+   else ch as an unsigned char value; in QUEUE_OVERWRITE mode it
+   always succeeds, dropping the oldest char if q was full */
 extern int enqueue(Queue *, char);
 
-/* take one char out of spec. queue, rets EMPTYQUE if q empty */
+/* take one char out of spec. queue, rets EMPTYQUE if q empty,
+   else the char as an unsigned char value (0..255) */
 extern int dequeue(Queue *);
 
 /* report on how many chars in queue now */
 extern int queuecount(Queue *);
 
+/* the char k places from the front (0: the one dequeue would return),
+   left in the queue, or EMPTYQUE if there are not that many-- */
+extern int queuepeek(Queue *, int k);
+
 /* returns TRUE or FALSE-- */
 extern int emptyqueue(Queue *);
 
+/* point *p at the chars from the front of the queue that lie
+   contiguously in memory, and return how many (0 if empty)-- */
+extern int queuespan(Queue *, char **p);
+
+/* discard n chars from the front, e.g. after using a queuespan--
+   returns number discarded */
+extern int queueskip(Queue *, int n);
+
+/* call fn(q, QUEUE_HIGH, arg) when enqueue brings the count up to
+   high, then fn(q, QUEUE_LOW, arg) when dequeue or queueskip brings
+   it back down to low, and so on: once per crossing, however long
+   the count stays there (fn 0: none; init_queue also clears it)-- */
+extern void queue_watermarks(Queue *q, int high, int low,
+			     void (*fn)(Queue *q, int which, void *arg),
+			     void *arg);
+
+/* look for ch among the first n chars, without removing any--
+   returns how many chars up to and including the first ch,
+   or 0 if it isn't there */
+extern int queuefind(Queue *, int ch, int n);
+
 #endif 
@@ -0,0 +1,100 @@
+/*
+ * program : rqueue.c
+ * by      : paul cardoos (after queue.c)
+ * date    : Apr. 2021
+ * purpose : record queue package: fixed-size records, bulk moves
+ * history :
+ *
+ * Unlike queue.c this keeps a count instead of wasting a slot, so
+ * all max records are usable, and wraps with a compare rather than
+ * a modulo.  Bulk moves copy at most two runs (front to the end of
+ * buf, then the start of it), a word at a time when they can.
+ */
+
+#include "rqueue.h"
+
+static void copy(char *to, char *from, int n);
+
+/* ------------------------------------------------------------------------ */
+int init_rqueue(RQueue *q, void *buf, int size, int max)
+{
+  if (size <= 0 || max <= 0)
+    return FALSE;
+  q->buf = (char *)buf;
+  q->size = size;
+  q->max = max;
+  q->front = 0;
+  q->count = 0;
+  return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+int renqueue(RQueue *q, void *rec)
+{
+  return renqueue_n(q, rec, 1) ? TRUE : FULLQUE;
+}
+
+/* ------------------------------------------------------------------------ */
+int rdequeue(RQueue *q, void *rec)
+{
+  return rdequeue_n(q, rec, 1) ? TRUE : EMPTYQUE;
+}
+
+/* ------------------------------------------------------------------------ */
+int renqueue_n(RQueue *q, void *recs, int n)
+{
+  int rear, first;
+
+  if (n > q->max - q->count)
+    n = q->max - q->count;
+  if (n <= 0)
+    return 0;
+  rear = q->front + q->count;
+  if (rear >= q->max)
+    rear -= q->max;
+  first = q->max - rear;	/* room before the end of buf */
+  if (first > n)
+    first = n;
+  copy(q->buf + rear * q->size, (char *)recs, first * q->size);
+  copy(q->buf, (char *)recs + first * q->size, (n - first) * q->size);
+  q->count += n;
+  return n;
+}
+
+/* ------------------------------------------------------------------------ */
+int rdequeue_n(RQueue *q, void *recs, int n)
+{
+  int first;
+
+  if (n > q->count)
+    n = q->count;
+  if (n <= 0)
+    return 0;
+  first = q->max - q->front;	/* records before the end of buf */
+  if (first > n)
+    first = n;
+  copy((char *)recs, q->buf + q->front * q->size, first * q->size);
+  copy((char *)recs + first * q->size, q->buf, (n - first) * q->size);
+  q->front += n;
+  if (q->front >= q->max)
+    q->front -= q->max;
+  q->count -= n;
+  return n;
+}
+
+/* ------------------------------------------------------------------------ */
+int rqueuecount(RQueue *q)
+{
+  return q->count;
+}
+
+/* no memcpy in the SAPC library.  Bytes: the records are the
+   caller's, of any type, and an (int *) copy of them would break C's
+   aliasing rules (and needs alignment we can't promise) */
+static void copy(char *to, char *from, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    to[i] = from[i];
+}
@@ -0,0 +1,45 @@
+/*
+ * file    : rqueue.h
+ * by      : paul cardoos (after queue.h)
+ * date    : Apr. 2021
+ * purpose : record queue package header file: a FIFO of fixed-size
+ *           records (ints, structs...) in caller-supplied storage,
+ *           for what Queue's chars can't hold
+ * history :
+ */
+
+#ifndef RQUEUE_H
+#define RQUEUE_H
+
+#include "queue.h"		/* TRUE, FALSE, EMPTYQUE, FULLQUE */
+
+typedef struct rqueue {
+  char *buf;                   /* max records of size bytes each */
+  int size;                    /* bytes per record */
+  int max;                     /* capacity, in records */
+  int front;                   /* index of the oldest record */
+  int count;                   /* current numbers of records in queue */
+} RQueue;
+
+/* functions prototype */
+/* set up q to hold max records of size bytes in buf, which must have
+   room for max * size bytes (e.g. an array of max records)-- */
+extern int init_rqueue(RQueue *q, void *buf, int size, int max);
+
+/* copy the record at rec in at the back--returns TRUE, or FULLQUE
+   if q is full */
+extern int renqueue(RQueue *q, void *rec);
+
+/* copy the oldest record out to rec and remove it--returns TRUE, or
+   EMPTYQUE if q is empty */
+extern int rdequeue(RQueue *q, void *rec);
+
+/* bulk versions: up to n records from/to the array recs--return
+   how many were moved */
+extern int renqueue_n(RQueue *q, void *recs, int n);
+extern int rdequeue_n(RQueue *q, void *recs, int n);
+
+/* report on how many records in queue now */
+extern int rqueuecount(RQueue *q);
+
+#endif
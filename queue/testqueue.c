@@ -9,8 +9,16 @@
 
 #include <stdio.h>
 #include "queue.h"
+#include "rqueue.h"
 /* the actual queue memory objects-- */
 Queue q1obj,q2obj;
+RQueue rqobj;
+int rqbuf[4];			/* storage for 4 int records */
+
+void mark(Queue *q, int which, void *arg)
+{
+  printf(" [%s at %d]", which == QUEUE_HIGH ? "high" : "low", queuecount(q));
+}
 int main()
 {
   int i, c;
@@ -53,5 +61,40 @@ int main()
   enqueue(q2,'d');
 
   printf("got %c from q2 \n", dequeue(q2));
+
+  printf("\nq2 in overwrite mode, 6 spots: put 'abcdefgh', dequeue all:");
+  init_queue_mode(q2, 6, QUEUE_OVERWRITE);
+  for (c = 'a'; c < 'i'; c++)
+      enqueue(q2, c);
+  while ((c = dequeue(q2)) != EMPTYQUE)
+      printf(" %c", c);
+  printf("\n%u overwritten (expect cdefgh, 2)\n", q2->overwritten);
+
+  printf("\nrecord queue of 4 ints: put 10..15 in bulk, 2 won't fit;\n");
+  init_rqueue(&rqobj, rqbuf, sizeof(int), 4);
+  {
+    int in[6] = {10, 11, 12, 13, 14, 15}, out[6];
+
+    printf("renqueue_n put %d, ", renqueue_n(&rqobj, in, 6));
+    rdequeue(&rqobj, &out[0]);
+    printf("rdequeue got %d, ", out[0]);
+    renqueue(&rqobj, &in[5]);
+    i = rdequeue_n(&rqobj, out, 6);
+    printf("then rdequeue_n got %d:", i);
+    for (c = 0; c < i; c++)
+      printf(" %d", out[c]);
+    printf(" (expect 4, 10, 4: 11 12 13 15)\n");
+  }
+
+  printf("\nq1 with watermarks high 4, low 1: put 6, take 6, put 6:\n");
+  init_queue(q1, 6);
+  queue_watermarks(q1, 4, 1, mark, 0);
+  for (i = 0; i < 6; i++)
+      enqueue(q1, 'a' + i);
+  for (i = 0; i < 6; i++)
+      dequeue(q1);
+  for (i = 0; i < 6; i++)
+      enqueue(q1, 'a' + i);
+  printf("\n(expect [high at 4] [low at 1] [high at 4])\n");
   return 0;
 }
@@ -0,0 +1,27 @@
+/*********************************************************************
+*
+*       file:           sim/include/cpu.h
+*       author:         paul cardoos
+*
+*       host (simulator) stand-in for the SAPC library's cpu.h:
+*       the interrupt flag and port i/o are modeled in sim.c
+*
+*/
+
+#ifndef CPU_H
+#define CPU_H
+
+typedef void IntHandler(void);
+
+void cli(void);
+void sti(void);
+int get_eflags(void);
+void set_eflags(int eflags);
+int inpt(int port);
+void outpt(int port, int val);
+void set_intr_gate(int n, IntHandler *handler);
+
+#define IRQ_TO_INT_N_SHIFT 0x20	/* PIC maps IRQ n to vector 0x20+n */
+#define EFLAGS_IF 0x200		/* interrupts enabled */
+
+#endif
@@ -0,0 +1,18 @@
+/*********************************************************************
+*
+*       file:           sim/include/pic.h
+*       author:         paul cardoos
+*
+*       host (simulator) stand-in for the SAPC library's pic.h:
+*       an edge-triggered 8259 is modeled in sim.c
+*
+*/
+
+#ifndef PIC_H
+#define PIC_H
+
+void pic_enable_irq(int irq);
+void pic_disable_irq(int irq);
+void pic_end_int(void);		/* non-specific EOI */
+
+#endif
@@ -0,0 +1,76 @@
+/*********************************************************************
+*
+*       file:           sim/include/serial.h
+*       author:         paul cardoos
+*
+*       host (simulator) copy of the SAPC library's serial.h: COM
+*       port addresses and 16550 register definitions
+*
+*/
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#define COM1_BASE 0x3f8
+#define COM2_BASE 0x2f8
+#define COM1_IRQ 4
+#define COM2_IRQ 3
+
+/* register offsets from the base port */
+#define UART_RX 0		/* receive buffer (read, DLAB 0) */
+#define UART_TX 0		/* transmit holding (write, DLAB 0) */
+#define UART_DLL 0		/* divisor latch low (DLAB 1) */
+#define UART_DLM 1		/* divisor latch high (DLAB 1) */
+#define UART_IER 1		/* interrupt enable */
+#define UART_IIR 2		/* interrupt id (read) */
+#define UART_FCR 2		/* FIFO control (write) */
+#define UART_LCR 3		/* line control */
+#define UART_MCR 4		/* modem control */
+#define UART_LSR 5		/* line status */
+#define UART_MSR 6		/* modem status */
+#define UART_SCR 7		/* scratch */
+
+#define UART_IER_RDI 0x01	/* receiver data */
+#define UART_IER_THRI 0x02	/* transmit holding register empty */
+#define UART_IER_RLSI 0x04	/* receiver line status */
+#define UART_IER_MSI 0x08	/* modem status */
+
+#define UART_IIR_NO_INT 0x01
+#define UART_IIR_ID 0x06
+#define UART_IIR_MSI 0x00
+#define UART_IIR_THRI 0x02
+#define UART_IIR_RDI 0x04
+#define UART_IIR_RLSI 0x06
+#define UART_IIR_TIMEOUT 0x0c	/* FIFO char timeout (RDI | 0x08) */
+#define UART_IIR_FIFO 0xc0	/* FIFOs enabled */
+
+#define UART_FCR_ENABLE_FIFO 0x01
+#define UART_FCR_CLEAR_RCVR 0x02
+#define UART_FCR_CLEAR_XMIT 0x04
+#define UART_FCR_TRIGGER_MASK 0xc0
+#define UART_FCR_TRIGGER_1 0x00
+#define UART_FCR_TRIGGER_4 0x40
+#define UART_FCR_TRIGGER_8 0x80
+#define UART_FCR_TRIGGER_14 0xc0
+
+#define UART_LCR_WLEN_MASK 0x03	/* word length - 5 */
+#define UART_LCR_STOP 0x04	/* 2 stop bits (1.5 for 5-bit words) */
+#define UART_LCR_PARITY 0x08
+#define UART_LCR_DLAB 0x80
+
+#define UART_MCR_DTR 0x01
+#define UART_MCR_RTS 0x02
+#define UART_MCR_OUT1 0x04
+#define UART_MCR_OUT2 0x08
+#define UART_MCR_LOOP 0x10
+
+#define UART_LSR_DR 0x01	/* data ready */
+#define UART_LSR_OE 0x02	/* overrun error */
+#define UART_LSR_THRE 0x20	/* transmit holding register empty */
+#define UART_LSR_TEMT 0x40	/* transmitter empty */
+
+#define UART_MSR_CTS 0x10
+#define UART_MSR_DSR 0x20
+#define UART_MSR_DCD 0x80
+
+#endif
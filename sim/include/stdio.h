@@ -0,0 +1,23 @@
+/*********************************************************************
+*
+*       file:           sim/include/stdio.h
+*       author:         paul cardoos
+*
+*       host (simulator) stdio.h: the host's, plus the SAPC library
+*       calls the drivers use (kprintf etc. come from sim.c)
+*
+*/
+
+#ifndef SIM_STDIO_H
+#define SIM_STDIO_H
+
+#include_next <stdio.h>
+#include <string.h>
+
+#define COM1 1			/* sys_get_console_dev() values */
+#define COM2 2
+
+int kprintf(char *fmt, ...);
+int sys_get_console_dev(void);
+
+#endif
@@ -0,0 +1,426 @@
+/*********************************************************************
+*
+*       file:           sim.c
+*       author:         paul cardoos
+*
+*       host simulator (see sim.h): virtual clock, CPU interrupt
+*       flag, edge-triggered 8259, 8254 channels 0 and 2, port i/o
+*       dispatch, and host versions of the SAPC library calls and
+*       the assembler interrupt envelopes (task.c and taskswitch.s
+*       run as they are, with sim_idle for the hlt)
+*
+*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <cpu.h>
+#include <pic.h>
+#include <serial.h>
+#include "sim.h"
+#include "uart.h"
+
+#define PIT_INPUT_HZ 1193182	/* as in pit.h */
+
+simtime sim_now;
+
+static int iflag;		/* CPU interrupt flag */
+static IntHandler *vectors[256];
+
+/* 8259: one bit per IRQ */
+static int pic_imr = 0xff;	/* masked */
+static int pic_irr;		/* requested */
+static int pic_isr;		/* in service */
+
+/* 8254 */
+static struct {
+  int latch[3];			/* count being written */
+  int lsb_next[3];		/* next data write is the low byte */
+  simtime period;		/* channel 0, or 0 before it is set */
+  simtime next_tick;
+  simtime ch2_done;		/* channel 2 (mode 0) reaches 0 */
+  int gate;			/* port 0x61 bits 0-1 */
+} pit;
+
+static struct uart uarts[2];	/* COM1, COM2 */
+
+static simtime next_event(void);
+static void run_events(void);
+static void update_lines(void);
+static void deliver(void);
+static struct uart *port_uart(int port);
+static int pit_in(int port);
+static void pit_out(int port, int val);
+static simtime pit_count_ns(int count);
+
+void sim_init(int baud)
+{
+  sim_now = 0;
+  iflag = 0;
+  pic_imr = 0xff;
+  pic_irr = pic_isr = 0;
+  pit.period = 0;
+  pit.ch2_done = SIM_NEVER;
+  pit.lsb_next[0] = pit.lsb_next[2] = 1;
+  uart_reset(&uarts[0], COM1_BASE, COM1_IRQ, baud);
+  uart_reset(&uarts[1], COM2_BASE, COM2_IRQ, baud);
+}
+
+/*====================================================================
+*       time
+====================================================================*/
+
+void sim_advance(simtime ns)
+{
+  simtime target = sim_now + ns, t;
+
+  for (;;) {
+    t = next_event();
+    if (t > target)
+      break;
+    if (t > sim_now)
+      sim_now = t;
+    run_events();
+    update_lines();
+    deliver();
+  }
+  if (sim_now < target)
+    sim_now = target;
+  update_lines();
+  deliver();
+}
+
+void sim_idle(void)
+{
+  int saved = iflag;
+  simtime t;
+
+  iflag = 1;
+  deliver();
+  t = next_event();
+  if (t == SIM_NEVER)
+    t = sim_now + 1000000;	/* nothing can ever happen: no hang */
+  sim_advance(t > sim_now ? t - sim_now : 1);
+  iflag = saved;
+}
+
+unsigned long long sim_rdtsc(void)
+{
+  return sim_now * SIM_CPU_MHZ / 1000;
+}
+
+static simtime next_event(void)
+{
+  simtime t = SIM_NEVER, u;
+  int i;
+
+  for (i = 0; i < 2; i++)
+    if ((u = uart_next_event(&uarts[i])) < t)
+      t = u;
+  if (pit.period && pit.next_tick < t)
+    t = pit.next_tick;
+  return t;
+}
+
+static void run_events(void)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+    uart_run(&uarts[i]);
+  while (pit.period && pit.next_tick <= sim_now) {
+    pic_irr |= 1 << 0;		/* OUT0 pulses once per count */
+    pit.next_tick += pit.period;
+  }
+}
+
+/*====================================================================
+*       interrupts
+====================================================================*/
+
+/* the 8259 latches a request on a rising INTR edge */
+static void update_lines(void)
+{
+  struct uart *u;
+  int i, level;
+
+  for (i = 0; i < 2; i++) {
+    u = &uarts[i];
+    level = uart_intr(u);
+    if (level && !u->irqline)
+      pic_irr |= 1 << u->irq;
+    u->irqline = level;
+  }
+}
+
+/* take requested interrupts above the priority of any in service */
+static void deliver(void)
+{
+  int req, irq;
+
+  while (iflag) {
+    req = pic_irr & ~pic_imr;
+    for (irq = 0; irq < 8; irq++)
+      if ((pic_isr & (1 << irq)) || (req & (1 << irq)))
+	break;
+    if (irq == 8 || !(req & (1 << irq)))
+      return;			/* none, or a higher one is in service */
+    pic_irr &= ~(1 << irq);
+    pic_isr |= 1 << irq;
+    iflag = 0;			/* through an interrupt gate */
+    sim_now += SIM_INT_NS;
+    if (vectors[irq + IRQ_TO_INT_N_SHIFT])
+      vectors[irq + IRQ_TO_INT_N_SHIFT]();
+    else
+      pic_isr &= ~(1 << irq);	/* the Tutor's default handler */
+    iflag = 1;			/* iret */
+  }
+}
+
+void cli(void)
+{
+  iflag = 0;
+}
+
+void sti(void)
+{
+  iflag = 1;
+  deliver();
+}
+
+int get_eflags(void)
+{
+  return iflag ? EFLAGS_IF | 2 : 2;
+}
+
+void set_eflags(int eflags)
+{
+  if (eflags & EFLAGS_IF)
+    sti();
+  else
+    cli();
+}
+
+void set_intr_gate(int n, IntHandler *handler)
+{
+  vectors[n] = handler;
+}
+
+void pic_enable_irq(int irq)
+{
+  pic_imr &= ~(1 << irq);
+}
+
+void pic_disable_irq(int irq)
+{
+  pic_imr |= 1 << irq;
+}
+
+void pic_end_int(void)
+{
+  pic_isr &= pic_isr - 1;	/* clear the highest priority (lowest) bit */
+}
+
+/*====================================================================
+*       port i/o
+====================================================================*/
+
+int inpt(int port)
+{
+  struct uart *u;
+  int v;
+
+  sim_advance(SIM_IO_NS);
+  if ((u = port_uart(port)) != 0)
+    v = uart_read(u, port - u->base);
+  else
+    v = pit_in(port);
+  update_lines();
+  return v;
+}
+
+void outpt(int port, int val)
+{
+  struct uart *u;
+
+  sim_advance(SIM_IO_NS);
+  if ((u = port_uart(port)) != 0)
+    uart_write(u, port - u->base, val);
+  else
+    pit_out(port, val);
+  update_lines();
+  deliver();
+}
+
+static struct uart *port_uart(int port)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+    if (port >= uarts[i].base && port < uarts[i].base + 8)
+      return &uarts[i];
+  return 0;
+}
+
+/*====================================================================
+*       8254: channel 0 in any periodic mode, channel 2 in mode 0
+====================================================================*/
+
+static int pit_in(int port)
+{
+  if (port == 0x61)
+    return pit.gate | (sim_now >= pit.ch2_done ? 0x20 : 0);
+  return 0xff;
+}
+
+static void pit_out(int port, int val)
+{
+  int ch;
+
+  val &= 0xff;
+  if (port == 0x43) {		/* command: select channel, lsb first */
+    pit.lsb_next[val >> 6 & 3] = 1;
+    return;
+  }
+  if (port == 0x61) {
+    pit.gate = val & 3;
+    return;
+  }
+  if (port != 0x40 && port != 0x42)
+    return;
+  ch = port - 0x40;
+  if (pit.lsb_next[ch]) {
+    pit.latch[ch] = val;
+    pit.lsb_next[ch] = 0;
+    return;
+  }
+  pit.latch[ch] |= val << 8;
+  pit.lsb_next[ch] = 1;
+  if (ch == 0) {
+    pit.period = pit_count_ns(pit.latch[0]);
+    pit.next_tick = sim_now + pit.period;
+  } else
+    pit.ch2_done = sim_now + pit_count_ns(pit.latch[2]);
+}
+
+static simtime pit_count_ns(int count)
+{
+  if (count == 0)
+    count = 0x10000;
+  return (simtime)count * 1000000000ULL / PIT_INPUT_HZ;
+}
+
+/*====================================================================
+*       the far ends of the COM lines
+====================================================================*/
+
+static struct uart *base_uart(int base)
+{
+  return base == COM1_BASE ? &uarts[0] : &uarts[1];
+}
+
+void sim_set_baud(int base, int baud)
+{
+  struct uart *u = base_uart(base);
+
+  u->dll = (UART_XTAL / 16 / baud) & 0xff;
+  u->dlm = (UART_XTAL / 16 / baud) >> 8;
+}
+
+simtime sim_char_ns(int base)
+{
+  return uart_char_ns(base_uart(base));
+}
+
+void sim_line_send(int base, char *buf, int n, simtime gap)
+{
+  struct uart *u = base_uart(base);
+
+  u->send = buf;
+  u->sendlen = n;
+  u->sendpos = 0;
+  u->gap = gap;
+  u->send_next = sim_now + uart_char_ns(u);
+}
+
+void sim_line_more(int base, int n)
+{
+  struct uart *u = base_uart(base);
+
+  u->sendlen += n;
+  if (u->send_next < sim_now + uart_char_ns(u)) /* the line was idle */
+    u->send_next = sim_now + uart_char_ns(u);
+}
+
+void sim_line_peer(int base, void (*fn)(int ch))
+{
+  base_uart(base)->peer = fn;
+}
+
+int sim_line_received(int base, char **buf, simtime *last)
+{
+  struct uart *u = base_uart(base);
+
+  if (buf)
+    *buf = u->recv;
+  if (last)
+    *last = u->recv_last;
+  return u->recvlen;
+}
+
+void sim_line_reset(int base)
+{
+  struct uart *u = base_uart(base);
+
+  u->sendlen = u->sendpos = 0;
+  u->recvlen = 0;
+  u->peer = 0;
+}
+
+unsigned int sim_overruns(int base)
+{
+  return base_uart(base)->overruns;
+}
+
+/*====================================================================
+*       SAPC library and assembler envelopes, for the host
+====================================================================*/
+
+int kprintf(char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vprintf(fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+int sys_get_console_dev(void)
+{
+  return COM2;
+}
+
+extern void irq0inthandc(void), irq3inthandc(void), irq4inthandc(void);
+extern void irq0profhandc(unsigned int *frame);
+
+void irq0inthand(void)
+{
+  irq0inthandc();
+}
+
+void irq3inthand(void)
+{
+  irq3inthandc();
+}
+
+void irq4inthand(void)
+{
+  irq4inthandc();
+}
+
+void irq0profhand(void)
+{
+  unsigned int frame[3] = {0, 0, 0}; /* no guest EIP on the host */
+
+  irq0profhandc(frame);
+}
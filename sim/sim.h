@@ -0,0 +1,59 @@
+/*********************************************************************
+*
+*       file:           sim.h
+*       author:         paul cardoos
+*
+*       host simulator for the SAPC drivers: a virtual clock, CPU
+*       interrupt flag, 8259 PIC, 8254 PIT and two 16550A UARTs,
+*       each with a far end that can send and receive at line rate
+*
+*       Virtual time only passes in port i/o (SIM_IO_NS each, about
+*       what an ISA access costs), interrupt entry (SIM_INT_NS) and
+*       while the drivers wait (task_sleep lets time run to the next
+*       event).  C code between port accesses is free, so the results
+*       show the limits the line and the i/o count set, not CPU speed.
+*
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+typedef unsigned long long simtime;	/* nanoseconds */
+
+#define SIM_NEVER (~0ULL)
+#define SIM_CPU_MHZ 500		/* virtual TSC rate */
+#define SIM_IO_NS 1000		/* one port access */
+#define SIM_INT_NS 2000		/* interrupt entry and iret */
+
+extern simtime sim_now;
+
+/* power on: both COM ports at baud, 8N1, as the Tutor leaves them */
+void sim_init(int baud);
+/* let ns of virtual time pass, taking interrupts if enabled */
+void sim_advance(simtime ns);
+/* run with interrupts on until the next event (cpu_idle's hlt) */
+void sim_idle(void);
+/* virtual TSC, for tsc.h */
+unsigned long long sim_rdtsc(void);
+
+/* the far end of the COM port at base: */
+/* change the line speed at both ends (as the Tutor "baud" would) */
+void sim_set_baud(int base, int baud);
+/* time one char takes on the line */
+simtime sim_char_ns(int base);
+/* send n chars to the UART, back to back plus gap between chars */
+void sim_line_send(int base, char *buf, int n, simtime gap);
+/* n more chars of sim_line_send's buf are ready to go */
+void sim_line_more(int base, int n);
+/* call fn with each char the far end receives (0: stop), so it can
+ * answer with sim_line_more, as a protocol peer would */
+void sim_line_peer(int base, void (*fn)(int ch));
+/* chars the far end has received since sim_line_reset, and when
+ * the last one finished arriving */
+int sim_line_received(int base, char **buf, simtime *last);
+/* forget what was sent and received */
+void sim_line_reset(int base);
+/* UART counters */
+unsigned int sim_overruns(int base);
+
+#endif
@@ -0,0 +1,900 @@
+/*********************************************************************
+*
+*       file:           simtty.c
+*       author:         paul cardoos
+*
+*       run the tty driver on the simulated 16550A at 9600 and
+*       115200 baud and report what a board would see
+*
+*       Each test talks to TTY0 (COM1), whose far end sends and
+*       checks the data, and prints one CSV line:
+*
+*       sim,test,baud,bytes,usec,bytes_per_sec,line_pct,ints,
+*           ints_per_kb,latency_us,busy_pct10
+*
+*       write    NBYTES written, until the last stop bit is out
+*       read     NBYTES sent back to back by the far end, and read
+*       echo     same, with echo on: until the echoes are all out
+*       latency  single chars with the line idle between them: the
+*                mean time from a char's stop bit to read returning
+*       lines    NBYTES of LINELEN-char lines, read with readuntil;
+*                they end in CR on the line, translated to NL
+*       gaps     NLAT chars a char time apart, read with readts: the
+*                mean of the times between them (two char times)
+*       chain    NBYTES written in place with writechain, as NCHAIN
+*                buffers, until the last stop bit is out
+*       flow     NBYTES sent back to back, read FLOWREAD at a time by
+*                a reader that only keeps up with half the line: RTS
+*                flow control must lose nothing
+*       kill     KILLSPAN chars taken with read_acquire, then a kill
+*                char and NLAT more: the span must stay put, and after
+*                read_release only the NLAT must be left
+*       lz       NBYTES of telemetry-like text lines written with LZ
+*                compression on, until the last stop bit is out, and
+*                decoded here; line_pct over 100 is the compression
+*                ratio (about 2.7:1), which must be at least 2:1.
+*                Then LZ is negotiated again, the far end answering our
+*                hello with its own and the same text compressed, while
+*                a class table drops the first compressed char: with
+*                the first LZCUT or more chars of it in, where the raw
+*                and decoded counts differ, READYCONTROL must count
+*                what they decode to.  Echo must be back on afterwards
+*       replay   NLAT chars a char time apart, recorded as they are
+*                read, then played back by the PIT timer with the line
+*                quiet and read again
+*       xfer     NBYTES sent with xfer_send to a peer at the far end
+*                that loses every XDROP'th data frame and the first
+*                END: all must arrive, with one resend per frame lost.
+*                Then xfer_recv with nobody sending must give up
+*       log      klog_init refused with COBS framing on; then, attached
+*                first, a message logged while framing is on must stay
+*                out of a LOGFRAME-char frame, and follow it once
+*                framing is off
+*       mux      on TTY1 (COM2): two tasks write MUXBYTES each on MUX0
+*                and MUX1 at once, while MUXIN come in on MUX2, and
+*                the far end gives credit back for what it gets: every
+*                frame must decode, and each channel's data be whole
+*
+*       line_pct is the share of the line's 8N1 capacity used, and
+*       busy_pct10 the CPU's, in tenths of a percent (LOADCONTROL;
+*       latency's idle line is sim_advance, which counts as busy).  The
+*       exit status is 1 if any data came out wrong.
+*
+*/
+#include <stdio.h>
+#include <serial.h>
+#include "sim.h"
+#include "../io_public.h"
+#include "../tty.h"		/* LZHELLO */
+#include "../lz.h"
+#include "../frame.h"
+#include "../crc.h"
+#include "../xfer.h"
+#include "../klog.h"
+#include "../task.h"
+#include "../mux.h"		/* MUXHDR, MUXBUF */
+
+#define NBYTES 4096
+#define NLAT 20			/* chars timed for latency */
+#define LINELEN 64		/* including the newline */
+#define NCHAIN 4		/* buffers in the writechain chain */
+#define FLOWREAD 16		/* chars per read in the flow test */
+#define KILLSPAN 8		/* chars acquired in the kill test */
+#define KILLCHAR 0x15		/* ^U */
+#define TLINE "t=0000 temp=21.0 volts=12.00 rpm=3000 ok\r\n"
+#define TLEN ((int)sizeof(TLINE) - 1)
+#define LZCUT 20		/* compressed chars in for READYCONTROL */
+#define XHDR 3			/* xfer frame: type, block number, */
+#define XFCS 2			/*   payload, CRC-16 */
+#define XBLKS (NBYTES / XFER_BLK)
+#define XDROP 7			/* the xfer peer loses every XDROP'th */
+#define PEEROUT 8192		/* xfer peer's answers, as sent */
+#define LOGFRAME 100		/* frame written with a message logged */
+#define LOGMSG "log held\n"	/* as logged; sent with \r\n */
+#define MUXBYTES NBYTES		/* written on MUX0 and on MUX1 */
+#define MUXIN 1024		/* sent in on MUX2 */
+#define MUXFRAME 16		/*   at most this much a frame */
+#define MUXOUT 8192		/* mux peer's frames, as sent */
+
+static char wbuf[NBYTES], rbuf[NBYTES], lbuf[NBYTES];
+static char crnl[256];		/* input translation: CR to NL */
+static char killcls[256];	/* input classes: KILLCHAR kills */
+static char kbuf[1 + NLAT];	/* KILLCHAR, then the start of wbuf */
+static char tbuf[NBYTES];	/* TLINEs, with the numbers changing */
+static struct lzdec lzdec;
+static struct lzenc lzenc;
+static char cbuf[NBYTES];	/* LZHELLO, then tbuf compressed */
+static int clen;
+static char lzdrop[256];	/* input classes: drop the first */
+				/*   compressed char */
+static int lzheard, lzanswer;	/* hello chars in, chars to answer */
+static struct ttyrec rec;
+
+/* the far end's side of an xfer_send */
+static struct framer pframe;
+static char pimg[NBYTES];	/* blocks received */
+static char phave[XBLKS];
+static int pexpect;		/* first block not received */
+static int pdata, pends;	/* D and E frames seen */
+static char pout[PEEROUT];
+static int poutlen;
+/* the far end's side of the mux */
+static struct framer mframe;
+static int mgot[2];		/* MUX0, MUX1 chars received */
+static int mbad;		/* frames that don't decode or fit */
+static int msent, mcredit;	/* MUX2 chars sent, and room for more */
+static char mout[MUXOUT];
+static int moutlen;
+static int statdev = TTY0;	/* whose interrupts report counts */
+static unsigned short tsbuf[NLAT];
+static struct iobuf chain[NCHAIN];
+static int released;		/* chain buffers done with */
+static struct ttystats st;	/* static: control() takes its address as
+				   an int, as on the 32-bit SAPC */
+static int bauds[] = {9600, 115200};
+#define NBAUDS (sizeof(bauds)/sizeof(bauds[0]))
+static int errors;
+
+static void sim_write(int baud);
+static void sim_read(int baud, int echo);
+static void sim_latency(int baud);
+static void sim_lines(int baud);
+static void sim_gaps(int baud);
+static void sim_chain(int baud);
+static void sim_flow(int baud);
+static void sim_kill(int baud);
+static void sim_lz(int baud);
+static void sim_replay(int baud);
+static void sim_xfer(int baud);
+static void sim_log(int baud);
+static void sim_mux(int baud);
+static void mux_writer(int dev);
+static void mux_reader(int dev);
+static void mux_peer(int ch);
+static void mux_data(int n);
+static void mux_send(char *f, int n);
+static void mux_put(void *arg, int ch);
+static void peer_rx(int ch);
+static void peer_send(int type, int n);
+static void peer_put(void *arg, int ch);
+static unsigned int get4(char *p);
+static void cput(void *arg, int ch);
+static int lz_count(char *buf, int n);
+static void peer_hello(int ch);
+static void telemetry(void);
+static void put_num(char *p, int v, int digits);
+static void chain_done(struct iobuf *b);
+static void start(int echo);
+static void check(char *test, char *got, int n, int want);
+static void report(char *test, int baud, int bytes, simtime ns,
+		   simtime latency);
+
+int main(void)
+{
+  unsigned int i;
+
+  for (i = 0; i < NBYTES; i++) {
+    wbuf[i] = 'a' + i % 26;
+    lbuf[i] = i % LINELEN == LINELEN - 1 ? '\r' : wbuf[i];
+  }
+  for (i = 0; i < 256; i++)
+    crnl[i] = i == '\r' ? '\n' : i;
+  killcls[KILLCHAR] = TTYC_KILL;
+  kbuf[0] = KILLCHAR;
+  for (i = 0; i < NLAT; i++)
+    kbuf[1 + i] = wbuf[i];
+  telemetry();
+  sim_init(bauds[0]);
+  ioinit();
+  printf("sim,test,baud,bytes,usec,bytes_per_sec,line_pct,ints,"
+	 "ints_per_kb,latency_us,busy_pct10\n");
+  for (i = 0; i < NBAUDS; i++) {
+    sim_set_baud(COM1_BASE, bauds[i]);
+    sim_write(bauds[i]);
+    sim_read(bauds[i], 0);
+    sim_read(bauds[i], 1);
+    sim_latency(bauds[i]);
+    sim_lines(bauds[i]);
+    sim_gaps(bauds[i]);
+    sim_chain(bauds[i]);
+    sim_flow(bauds[i]);
+    sim_kill(bauds[i]);
+    sim_lz(bauds[i]);
+    sim_replay(bauds[i]);
+    sim_xfer(bauds[i]);
+    sim_log(bauds[i]);
+    sim_mux(bauds[i]);
+  }
+  return errors ? 1 : 0;
+}
+
+static void sim_write(int baud)
+{
+  simtime t0;
+  char *got;
+  int n;
+
+  start(0);
+  t0 = sim_now;
+  write(TTY0, wbuf, NBYTES);
+  control(TTY0, DRAINCONTROL, 0);
+  n = sim_line_received(COM1_BASE, &got, 0);
+  check("write", got, n, NBYTES);
+  report("write", baud, NBYTES, sim_now - t0, 0);
+}
+
+static void sim_read(int baud, int echo)
+{
+  simtime t0, last;
+  char *got;
+  int n;
+
+  start(echo);
+  t0 = sim_now;
+  sim_line_send(COM1_BASE, wbuf, NBYTES, 0);
+  read(TTY0, rbuf, NBYTES);
+  check("read", rbuf, NBYTES, NBYTES);
+  if (echo) {
+    control(TTY0, DRAINCONTROL, 0);
+    n = sim_line_received(COM1_BASE, &got, &last);
+    check("echo", got, n, NBYTES);
+  }
+  report(echo ? "echo" : "read", baud, NBYTES, sim_now - t0, 0);
+}
+
+static void sim_latency(int baud)
+{
+  simtime t0, sent, total = 0;
+  int i;
+
+  start(0);
+  t0 = sim_now;
+  for (i = 0; i < NLAT; i++) {
+    sim_line_send(COM1_BASE, wbuf + i, 1, 0);
+    sent = sim_now + sim_char_ns(COM1_BASE); /* its stop bit */
+    read(TTY0, rbuf + i, 1);
+    total += sim_now - sent;
+    sim_advance(10 * sim_char_ns(COM1_BASE)); /* let the line go idle */
+  }
+  check("latency", rbuf, NLAT, NLAT);
+  report("latency", baud, NLAT, sim_now - t0, total / NLAT);
+}
+
+static void sim_lines(int baud)
+{
+  simtime t0;
+  int got, n;
+
+  start(0);
+  control(TTY0, XLATECONTROL, (int)crnl);
+  t0 = sim_now;
+  sim_line_send(COM1_BASE, lbuf, NBYTES, 0);
+  for (got = 0; got < NBYTES; got += n) {
+    n = readuntil(TTY0, rbuf + got, 2 * LINELEN, '\n');
+    if (n != LINELEN || rbuf[got + n - 1] != '\n') {
+      printf("sim,error,lines: record of %d chars at %d\n", n, got);
+      errors++;
+      if (n <= 0)
+	return;
+    }
+  }
+  control(TTY0, XLATECONTROL, 0);
+  report("lines", baud, NBYTES, sim_now - t0, 0);
+}
+
+static void sim_gaps(int baud)
+{
+  simtime t0, gap, ns, total = 0;
+  int i;
+
+  start(0);
+  control(TTY0, TSCONTROL, 1);
+  t0 = sim_now;
+  gap = sim_char_ns(COM1_BASE);
+  sim_line_send(COM1_BASE, wbuf, NLAT, gap);
+  if (readts(TTY0, rbuf, tsbuf, NLAT) != NLAT) {
+    printf("sim,error,gaps: readts failed\n");
+    errors++;
+    return;
+  }
+  control(TTY0, TSCONTROL, 0);
+  check("gaps", rbuf, NLAT, NLAT);
+  for (i = 1; i < NLAT; i++) {	/* the first is from TSCONTROL */
+    ns = ((simtime)tsbuf[i] << TTY_TSSHIFT) * 1000 / SIM_CPU_MHZ;
+    if (ns + gap / 4 < 2 * gap || ns > 2 * gap + gap / 4) {
+      printf("sim,error,gaps: char %d came %u us after the one before\n",
+	     i, (unsigned int)(ns / 1000));
+      errors++;
+    }
+    total += ns;
+  }
+  report("gaps", baud, NLAT, sim_now - t0, total / (NLAT - 1));
+}
+
+static void sim_chain(int baud)
+{
+  simtime t0;
+  char *got;
+  int i, n;
+
+  start(0);
+  for (i = 0; i < NCHAIN; i++) {
+    chain[i].data = wbuf + i * (NBYTES / NCHAIN);
+    chain[i].len = NBYTES / NCHAIN;
+    chain[i].next = i + 1 < NCHAIN ? &chain[i + 1] : 0;
+    chain[i].done = chain_done;
+  }
+  released = 0;
+  t0 = sim_now;
+  writechain(TTY0, chain);
+  control(TTY0, DRAINCONTROL, 0);
+  n = sim_line_received(COM1_BASE, &got, 0);
+  check("chain", got, n, NBYTES);
+  if (released != NCHAIN) {
+    printf("sim,error,chain: %d of %d buffers released\n", released, NCHAIN);
+    errors++;
+  }
+  report("chain", baud, NBYTES, sim_now - t0, 0);
+}
+
+static void sim_flow(int baud)
+{
+  simtime t0;
+  int got;
+
+  start(0);
+  control(TTY0, FLOWCONTROL, 1);
+  t0 = sim_now;
+  sim_line_send(COM1_BASE, wbuf, NBYTES, 0);
+  for (got = 0; got < NBYTES; got += FLOWREAD) {
+    read(TTY0, rbuf + got, FLOWREAD);
+    sim_advance(2 * FLOWREAD * sim_char_ns(COM1_BASE)); /* busy elsewhere */
+  }
+  control(TTY0, FLOWCONTROL, 0);
+  check("flow", rbuf, NBYTES, NBYTES);
+  control(TTY0, STATSCONTROL, (int)&st);
+  if (st.rxdropped) {
+    printf("sim,error,flow: %u chars dropped\n", st.rxdropped);
+    errors++;
+  }
+  report("flow", baud, NBYTES, sim_now - t0, 0);
+}
+
+static void sim_kill(int baud)
+{
+  simtime t0;
+  char *p;
+  int n;
+
+  start(0);
+  control(TTY0, CLASSCONTROL, (int)killcls);
+  t0 = sim_now;
+  sim_line_send(COM1_BASE, wbuf, KILLSPAN, 0);
+  sim_advance((KILLSPAN + 1) * sim_char_ns(COM1_BASE));
+  read_acquire(TTY0, &p, &n);
+  if (n != KILLSPAN) {
+    printf("sim,error,kill: acquired %d chars, not %d\n", n, KILLSPAN);
+    errors++;
+  }
+  sim_line_send(COM1_BASE, kbuf, 1 + NLAT, 0);
+  sim_advance((NLAT + 8) * sim_char_ns(COM1_BASE)); /* + FIFO timeout */
+  for (n = 0; n < KILLSPAN; n++)
+    if (p[n] != wbuf[n]) {
+      printf("sim,error,kill: acquired char %d changed\n", n);
+      errors++;
+      break;
+    }
+  read_release(TTY0, KILLSPAN / 2);
+  n = control(TTY0, READYCONTROL, 0);
+  if (n > NLAT)			/* don't block on a short count */
+    n = NLAT;
+  read(TTY0, rbuf, n);
+  control(TTY0, CLASSCONTROL, 0);
+  check("kill", rbuf, n, NLAT);
+  report("kill", baud, KILLSPAN + 1 + NLAT, sim_now - t0, 0);
+}
+
+static void sim_lz(int baud)
+{
+  simtime t0;
+  char *got, *hello = LZHELLO;
+  int i, n, ch, out, hlen, cut;
+
+  start(1);
+  for (hlen = 0; hello[hlen]; hlen++)
+    ;
+  sim_line_send(COM1_BASE, hello, hlen, 0); /* the far end agrees */
+  if (control(TTY0, LZCONTROL, 1) < 0) {
+    printf("sim,error,lz: negotiation failed\n");
+    errors++;
+    return;
+  }
+  t0 = sim_now;
+  write(TTY0, tbuf, NBYTES);
+  control(TTY0, DRAINCONTROL, 0);
+  n = sim_line_received(COM1_BASE, &got, 0);
+  lz_dec_init(&lzdec);
+  out = 0;
+  for (i = hlen; i < n; i++) {	/* our LZHELLO goes out uncompressed */
+    ch = lz_input(&lzdec, got[i] & 0xff);
+    do {
+      if (ch != LZ_NONE && out < NBYTES)
+	rbuf[out++] = ch;
+    } while ((ch = lz_next(&lzdec)) != LZ_NONE);
+  }
+  for (i = 0; i < out && rbuf[i] == tbuf[i]; i++)
+    ;
+  if (out != NBYTES || i != NBYTES) {
+    printf("sim,error,lz: decoded %d chars, first %d right\n", out, i);
+    errors++;
+  }
+  if (n - hlen > NBYTES / 2) {
+    printf("sim,error,lz: %d chars compressed to %d\n", NBYTES, n - hlen);
+    errors++;
+  }
+  report("lz", baud, NBYTES, sim_now - t0, 0);
+
+  /* again, with the far end answering our hello with its own and
+   * data at once, and a class table that would drop some of it */
+  control(TTY0, LZCONTROL, 0);
+  for (clen = 0; clen < hlen; clen++)
+    cbuf[clen] = hello[clen];
+  lz_enc_init(&lzenc);
+  lz_encode(&lzenc, tbuf, NBYTES, cput, 0);
+  for (cut = LZCUT; lz_count(cbuf + hlen, cut) == cut; cut++)
+    ;
+  lzdrop[cbuf[hlen] & 0xff] = TTYC_DROP;
+  control(TTY0, CLASSCONTROL, (int)lzdrop);
+  lzheard = 0;
+  lzanswer = hlen + cut;
+  sim_line_send(COM1_BASE, cbuf, 0, 0);
+  sim_line_peer(COM1_BASE, peer_hello);
+  if (control(TTY0, LZCONTROL, 1) < 0) {
+    printf("sim,error,lz: second negotiation failed\n");
+    errors++;
+    return;
+  }
+  sim_advance((cut + 8) * sim_char_ns(COM1_BASE)); /* + FIFO timeout */
+  if ((n = control(TTY0, READYCONTROL, 0)) != lz_count(cbuf + hlen, cut)) {
+    printf("sim,error,lz: ready %d, but %d chars decode\n", n,
+	   lz_count(cbuf + hlen, cut));
+    errors++;
+    return;			/* reading n could wait for ever */
+  }
+  read(TTY0, rbuf, n);
+  sim_line_more(COM1_BASE, clen - hlen - cut);
+  read(TTY0, rbuf + n, NBYTES - n);
+  for (i = 0; i < NBYTES && rbuf[i] == tbuf[i]; i++)
+    ;
+  if (i != NBYTES) {
+    printf("sim,error,lz: read char %d wrong\n", i);
+    errors++;
+  }
+
+  control(TTY0, LZCONTROL, 0);
+  control(TTY0, CLASSCONTROL, 0);
+  lzdrop[cbuf[hlen] & 0xff] = 0;
+  sim_line_reset(COM1_BASE);
+  sim_line_send(COM1_BASE, wbuf, 1, 0);
+  read(TTY0, rbuf, 1);
+  control(TTY0, DRAINCONTROL, 0);
+  if (sim_line_received(COM1_BASE, &got, 0) != 1 || got[0] != wbuf[0]) {
+    printf("sim,error,lz: echo not back on\n");
+    errors++;
+  }
+}
+
+static void sim_replay(int baud)
+{
+  simtime t0;
+
+  start(0);
+  control(TTY0, RECORDCONTROL, 1);
+  sim_line_send(COM1_BASE, wbuf, NLAT, sim_char_ns(COM1_BASE));
+  read(TTY0, rbuf, NLAT);
+  control(TTY0, RECORDCONTROL, 0);
+  control(TTY0, RECGETCONTROL, (int)&rec);
+  if (rec.lost) {
+    printf("sim,error,replay: %d events lost\n", rec.lost);
+    errors++;
+  }
+  start(0);
+  t0 = sim_now;
+  control(TTY0, REPLAYCONTROL, (int)&rec);
+  read(TTY0, rbuf, NLAT);
+  check("replay", rbuf, NLAT, NLAT);
+  if (control(TTY0, REPLAYCONTROL, 0) != 0) {
+    printf("sim,error,replay: events left over\n");
+    errors++;
+  }
+  report("replay", baud, NLAT, sim_now - t0, 0);
+}
+
+static void sim_xfer(int baud)
+{
+  simtime t0;
+  int i, n;
+
+  start(0);
+  frame_reset(&pframe, FRAME_COBS);
+  for (i = 0; i < XBLKS; i++)
+    phave[i] = 0;
+  pexpect = pdata = pends = poutlen = 0;
+  sim_line_send(COM1_BASE, pout, 0, 0);
+  sim_line_peer(COM1_BASE, peer_rx);
+  t0 = sim_now;
+  if ((n = xfer_send(TTY0, wbuf, NBYTES)) != NBYTES) {
+    printf("sim,error,xfer: xfer_send returned %d\n", n);
+    errors++;
+  }
+  check("xfer", pimg, pexpect * XFER_BLK, NBYTES);
+  if (pdata <= XBLKS || pends < 2) {
+    printf("sim,error,xfer: nothing was resent\n");
+    errors++;
+  }
+  if (pdata - XBLKS > pdata / XDROP) {
+    printf("sim,error,xfer: %d blocks resent for %d lost\n",
+	   pdata - XBLKS, pdata / XDROP);
+    errors++;
+  }
+  report("xfer", baud, NBYTES, sim_now - t0, 0);
+
+  if (xfer_send(TTY0, wbuf, XFER_MAXBLKS * XFER_BLK + 1) != -1) {
+    printf("sim,error,xfer: took an image too big to number\n");
+    errors++;
+  }
+  start(0);
+  if ((n = xfer_recv(TTY0, rbuf, NBYTES)) != -1) {
+    printf("sim,error,xfer: xfer_recv from nobody returned %d\n", n);
+    errors++;
+  }
+}
+
+static void sim_log(int baud)
+{
+  simtime t0;
+  char *got, *msg = LOGMSG;
+  int i, n;
+
+  start(0);
+  control(TTY0, FRAMECONTROL, FRAME_COBS);
+  if (klog_init(TTY0) != -1) {
+    printf("sim,error,log: klog_init took a framed tty\n");
+    errors++;
+  }
+  control(TTY0, FRAMECONTROL, FRAME_NONE);
+  if (klog_init(TTY0) != 0) {
+    printf("sim,error,log: klog_init refused a plain tty\n");
+    errors++;
+    return;
+  }
+  control(TTY0, FRAMECONTROL, FRAME_COBS);
+  t0 = sim_now;
+  klogf(LOGMSG);
+  write(TTY0, wbuf, LOGFRAME);
+  control(TTY0, DRAINCONTROL, 0);
+  clen = 0;
+  frame_tx(FRAME_COBS, wbuf, LOGFRAME, cput, 0);
+  n = sim_line_received(COM1_BASE, &got, 0);
+  for (i = 0; i < n && i < clen && got[i] == cbuf[i]; i++)
+    ;
+  if (n != clen || i != clen) {
+    printf("sim,error,log: %d chars sent for a %d-char frame\n", n, clen);
+    errors++;
+  }
+  control(TTY0, FRAMECONTROL, FRAME_NONE);
+  klog_flush();
+  n = sim_line_received(COM1_BASE, &got, 0);
+  for (i = 0; msg[i] != '\n'; i++)
+    if (clen + i >= n || got[clen + i] != msg[i])
+      break;
+  if (msg[i] != '\n' || n != clen + i + 2) {
+    printf("sim,error,log: message not sent after the frame\n");
+    errors++;
+  }
+  report("log", baud, n, sim_now - t0, 0);
+}
+
+static void sim_mux(int baud)
+{
+  simtime t0, deadline;
+  int i, t[3];
+
+  start(0);
+  sim_set_baud(COM2_BASE, baud);
+  sim_line_reset(COM2_BASE);
+  control(TTY1, ECHOCONTROL, 0);
+  control(TTY1, STATSRESET, 0);
+  frame_reset(&mframe, FRAME_COBS);
+  mgot[0] = mgot[1] = mbad = msent = moutlen = 0;
+  mcredit = MUXBUF - 1;		/* as muxinit gives */
+  sim_line_send(COM2_BASE, mout, 0, 0);
+  sim_line_peer(COM2_BASE, mux_peer);
+  t0 = sim_now;
+  mux_data(MUXFRAME);		/* MUX2's first, unasked */
+  t[0] = task_create(mux_writer, MUX0);
+  t[1] = task_create(mux_writer, MUX1);
+  t[2] = task_create(mux_reader, MUX2);
+  if (t[0] < 0 || t[1] < 0 || t[2] < 0) {
+    printf("sim,error,mux: task_create failed\n");
+    errors++;
+    return;
+  }
+  /* a garbled frame loses credit, and the tasks then wait for ever:
+   * give them four times what the line needs */
+  deadline = sim_now + 4ULL * (2 * MUXBYTES + MUXIN) * sim_char_ns(COM2_BASE);
+  for (;;) {
+    for (i = 0; i < 3 && tasktab[t[i]].state == TASK_DONE; i++)
+      ;
+    if (i == 3 || sim_now >= deadline)
+      break;
+    control(PIT0, SLEEPCONTROL, 1);
+  }
+  if (i < 3) {
+    printf("sim,error,mux: stuck after %d bad frames\n", mbad);
+    errors++;
+    return;
+  }
+  control(TTY1, DRAINCONTROL, 0);
+  for (i = 0; i < MUXIN && rbuf[i] == lbuf[i]; i++)
+    ;
+  if (i != MUXIN) {
+    printf("sim,error,mux: MUX2 char %d wrong\n", i);
+    errors++;
+  }
+  if (mbad || mgot[0] != MUXBYTES || mgot[1] != MUXBYTES) {
+    printf("sim,error,mux: %d bad frames, %d and %d chars in\n",
+	   mbad, mgot[0], mgot[1]);
+    errors++;
+  }
+  statdev = TTY1;
+  report("mux", baud, 2 * MUXBYTES + MUXIN, sim_now - t0, 0);
+  statdev = TTY0;
+  control(MUX0, MUXDETACHCONTROL, 0);
+  sim_line_reset(COM2_BASE);
+}
+
+/* MUX0 sends wbuf, MUX1 tbuf */
+static void mux_writer(int dev)
+{
+  write(dev, dev == MUX0 ? wbuf : tbuf, MUXBYTES);
+}
+
+static void mux_reader(int dev)
+{
+  read(dev, rbuf, MUXIN);
+}
+
+/* each char the mux puts on the line: check each frame, credit data
+ * as it comes, and send MUX2's data as it is credited */
+static void mux_peer(int ch)
+{
+  char *f = mframe.buf, *want;
+  int len, chan, i;
+
+  if ((len = frame_rx(&mframe, ch)) == FRAME_MORE)
+    return;
+  if (len < MUXHDR) {
+    mbad++;			/* FRAME_BAD, or too short */
+    return;
+  }
+  chan = f[1] & 0xff;
+  if (f[0] == 'D' && chan < 2) {
+    want = (chan == 0 ? wbuf : tbuf) + mgot[chan];
+    for (i = MUXHDR; i < len; i++)
+      if (mgot[chan] + i - MUXHDR >= MUXBYTES ||
+	  f[i] != want[i - MUXHDR]) {
+	mbad++;
+	return;
+      }
+    len -= MUXHDR;
+    mgot[chan] += len;
+    f[0] = 'C';			/* 'C', chan, count: read at once */
+    f[2] = len & 0xff;
+    f[3] = len >> 8;
+    mux_send(f, MUXHDR + 2);
+  } else if (f[0] == 'C' && chan == 2 && len == MUXHDR + 2) {
+    mcredit += (f[2] & 0xff) | (f[3] & 0xff) << 8;
+    while (msent < MUXIN && mcredit > 0)
+      mux_data(mcredit < MUXFRAME ? mcredit : MUXFRAME);
+  } else
+    mbad++;
+}
+
+/* the next n chars of MUX2's data, out of the credit */
+static void mux_data(int n)
+{
+  char f[MUXHDR + MUXFRAME];
+  int i;
+
+  if (n > MUXIN - msent)
+    n = MUXIN - msent;
+  f[0] = 'D';
+  f[1] = 2;
+  for (i = 0; i < n; i++)
+    f[MUXHDR + i] = lbuf[msent + i];
+  msent += n;
+  mcredit -= n;
+  mux_send(f, MUXHDR + n);
+}
+
+/* one frame to the mux */
+static void mux_send(char *f, int n)
+{
+  int was = moutlen;
+
+  frame_tx(FRAME_COBS, f, n, mux_put, 0);
+  sim_line_more(COM2_BASE, moutlen - was);
+}
+
+static void mux_put(void *arg, int ch)
+{
+  if (moutlen < MUXOUT)
+    mout[moutlen++] = ch;
+}
+
+/* each char xfer_send puts on the line: answer frames as xfer_recv
+ * would, but losing some, and NAKing every block past a gap, not
+ * just the first, to see that the sender resends it only once */
+static void peer_rx(int ch)
+{
+  char *f = pframe.buf;
+  int len, blk, plen, ok;
+
+  if ((len = frame_rx(&pframe, ch)) < XHDR + XFCS)
+    return;			/* not a whole frame yet, or bad */
+  if (crc16(0, f, len - XFCS) !=
+      ((f[len - 2] & 0xff) | (f[len - 1] & 0xff) << 8))
+    return;
+  blk = (f[1] & 0xff) | (f[2] & 0xff) << 8;
+  plen = len - XHDR - XFCS;
+  if (f[0] == 'D') {
+    if (++pdata % XDROP == 0)
+      return;			/* lost on the line */
+    if (blk < XBLKS && !phave[blk]) {
+      for (ch = 0; ch < plen; ch++)
+	pimg[blk * XFER_BLK + ch] = f[XHDR + ch];
+      phave[blk] = 1;
+    }
+    while (pexpect < XBLKS && phave[pexpect])
+      pexpect++;
+    peer_send(blk > pexpect ? 'N' : 'A', pexpect);
+  } else if (f[0] == 'E' && plen == 8) {
+    if (++pends == 1)
+      return;			/* lose this one too */
+    ok = pexpect == XBLKS && get4(f + XHDR) == NBYTES &&
+      crc32(0, pimg, NBYTES) == get4(f + XHDR + 4);
+    peer_send('F', ok);
+  }
+}
+
+static void peer_send(int type, int n)
+{
+  char f[XHDR + XFCS];
+  unsigned int fcs;
+  int was = poutlen;
+
+  f[0] = type;
+  f[1] = n & 0xff;
+  f[2] = n >> 8;
+  fcs = crc16(0, f, XHDR);
+  f[3] = fcs & 0xff;
+  f[4] = fcs >> 8;
+  frame_tx(FRAME_COBS, f, XHDR + XFCS, peer_put, 0);
+  sim_line_more(COM1_BASE, poutlen - was);
+}
+
+static void peer_put(void *arg, int ch)
+{
+  if (poutlen < PEEROUT)
+    pout[poutlen++] = ch;
+}
+
+/* an END frame's little-endian length or CRC-32 */
+static unsigned int get4(char *p)
+{
+  return (p[0] & 0xff) | (p[1] & 0xff) << 8 | (p[2] & 0xff) << 16 |
+    (unsigned int)(p[3] & 0xff) << 24;
+}
+
+static void cput(void *arg, int ch)
+{
+  if (clen < NBYTES)
+    cbuf[clen++] = ch;
+}
+
+/* the far end of an LZ negotiation: answer our hello */
+static void peer_hello(int ch)
+{
+  if (++lzheard == sizeof(LZHELLO) - 1)
+    sim_line_more(COM1_BASE, lzanswer);
+}
+
+/* chars the first n of compressed buf decode to */
+static int lz_count(char *buf, int n)
+{
+  int i, ch, out = 0;
+
+  lz_dec_init(&lzdec);
+  for (i = 0; i < n; i++) {
+    ch = lz_input(&lzdec, buf[i] & 0xff);
+    do
+      if (ch != LZ_NONE)
+	out++;
+    while ((ch = lz_next(&lzdec)) != LZ_NONE);
+  }
+  return out;
+}
+
+/* NBYTES of TLINEs, as a data logger might send them */
+static void telemetry(void)
+{
+  char line[TLEN];
+  int i, j, n;
+
+  for (i = n = 0; n < NBYTES; i++) {
+    for (j = 0; j < TLEN; j++)
+      line[j] = TLINE[j];
+    put_num(line + 2, i, 4);
+    put_num(line + 15, i * 7 % 10, 1);
+    put_num(line + 26, 12 - i % 3, 2);
+    put_num(line + 33, 3000 + i * 13 % 50, 4);
+    for (j = 0; j < TLEN && n < NBYTES; j++)
+      tbuf[n++] = line[j];
+  }
+}
+
+/* v in digits decimal digits at p, zero-filled */
+static void put_num(char *p, int v, int digits)
+{
+  while (digits--) {
+    p[digits] = '0' + v % 10;
+    v /= 10;
+  }
+}
+
+static void chain_done(struct iobuf *b)
+{
+  released++;
+}
+
+static void start(int echo)
+{
+  sim_line_reset(COM1_BASE);
+  control(TTY0, ECHOCONTROL, echo);
+  control(TTY0, FLUSHCONTROL, 0);
+  control(TTY0, STATSRESET, 0);
+  control(PIT0, LOADCONTROL, 0);
+}
+
+/* got should be the first want chars of wbuf, n of them */
+static void check(char *test, char *got, int n, int want)
+{
+  int i;
+
+  if (n != want) {
+    printf("sim,error,%s: %d chars, not %d\n", test, n, want);
+    errors++;
+    return;
+  }
+  for (i = 0; i < n; i++)
+    if (got[i] != wbuf[i]) {
+      printf("sim,error,%s: char %d is %02x, not %02x\n", test, i,
+	     got[i] & 0xff, wbuf[i] & 0xff);
+      errors++;
+      return;
+    }
+}
+
+static void report(char *test, int baud, int bytes, simtime ns,
+		   simtime latency)
+{
+  unsigned int bps, busy;
+
+  busy = control(PIT0, LOADCONTROL, 0);
+  control(statdev, STATSCONTROL, (int)&st);
+  bps = (simtime)bytes * 1000000000ULL / ns;
+  printf("sim,%s,%d,%d,%u,%u,%u,%u,%u,%u,%u\n", test, baud, bytes,
+	 (unsigned int)(ns / 1000), bps, bps * 10 * 100 / baud, st.ints,
+	 st.ints * 1024 / bytes, (unsigned int)(latency / 1000), busy);
+}
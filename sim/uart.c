@@ -0,0 +1,312 @@
+/*********************************************************************
+*
+*       file:           uart.c
+*       author:         paul cardoos
+*
+*       16550A model for the simulator (see uart.h)
+*
+*       Interrupt sources, highest priority first, as the 16550A:
+*         line status  overrun, if IER RLSI
+*         rx data      FIFO at the trigger level (1 char, no FIFO)
+*         timeout      FIFO not empty, nothing in or out for 4 chars
+*         THRE         tx FIFO went empty (or THRI was just enabled
+*                      with it empty); cleared by reading IIR while
+*                      it is the one shown, or by writing THR
+*       Modem status interrupts and break/parity/framing errors are
+*       not modeled.
+*
+*/
+#include <serial.h>
+#include "uart.h"
+
+#define CTS_UP(mcr) ((mcr) & (UART_MCR_RTS | UART_MCR_LOOP))
+
+static void rx_in(struct uart *u, int ch);
+static void tx_out(struct uart *u, int ch);
+static void load_tsr(struct uart *u);
+static int far_sends(struct uart *u);
+static int iir(struct uart *u);
+static int depth(struct uart *u);
+static simtime bit_ns(struct uart *u);
+static int char_bits(struct uart *u);
+
+void uart_reset(struct uart *u, int base, int irq, int baud)
+{
+  u->base = base;
+  u->irq = irq;
+  u->irqline = 0;
+  u->ier = u->fcr = u->scr = 0;
+  u->lcr = 0x03;		/* 8N1 */
+  u->mcr = UART_MCR_DTR | UART_MCR_RTS | UART_MCR_OUT2;
+  u->cts_off = 0;
+  u->dll = (UART_XTAL / 16 / baud) & 0xff;
+  u->dlm = (UART_XTAL / 16 / baud) >> 8;
+  u->rxhead = u->rxcount = u->oe = 0;
+  u->rx_touch = sim_now;
+  u->txhead = u->txcount = 0;
+  u->load_at = SIM_NEVER;
+  u->tsr_busy = 0;
+  u->thre_int = 0;
+  u->send = 0;
+  u->sendlen = u->sendpos = 0;
+  u->recvlen = 0;
+  u->recv_last = 0;
+  u->peer = 0;
+  u->overruns = 0;
+}
+
+/*====================================================================
+*       registers
+====================================================================*/
+
+int uart_read(struct uart *u, int reg)
+{
+  int v;
+
+  if (u->lcr & UART_LCR_DLAB) {
+    if (reg == UART_DLL)
+      return u->dll;
+    if (reg == UART_DLM)
+      return u->dlm;
+  }
+  switch (reg) {
+  case UART_RX:
+    if (u->rxcount == 0)
+      return 0;
+    v = u->rxf[u->rxhead];
+    u->rxhead = (u->rxhead + 1) % UART_FIFOLEN;
+    u->rxcount--;
+    u->rx_touch = sim_now;
+    return v;
+  case UART_IER:
+    return u->ier;
+  case UART_IIR:
+    v = iir(u);
+    if ((v & 0x0f) == UART_IIR_THRI)
+      u->thre_int = 0;		/* reading it is the acknowledgement */
+    return v | (u->fcr & UART_FCR_ENABLE_FIFO ? UART_IIR_FIFO : 0);
+  case UART_LCR:
+    return u->lcr;
+  case UART_MCR:
+    return u->mcr;
+  case UART_LSR:
+    v = 0;
+    if (u->rxcount)
+      v |= UART_LSR_DR;
+    if (u->oe)
+      v |= UART_LSR_OE;
+    if (u->txcount == 0)
+      v |= UART_LSR_THRE;
+    if (u->txcount == 0 && !u->tsr_busy && u->load_at == SIM_NEVER)
+      v |= UART_LSR_TEMT;
+    u->oe = 0;
+    return v;
+  case UART_MSR:
+    if (u->mcr & UART_MCR_LOOP)	/* outputs fed back to the inputs */
+      return (u->mcr & UART_MCR_RTS ? UART_MSR_CTS : 0) |
+	(u->mcr & UART_MCR_DTR ? UART_MSR_DSR : 0) |
+	(u->mcr & UART_MCR_OUT2 ? UART_MSR_DCD : 0);
+    return UART_MSR_CTS | UART_MSR_DSR | UART_MSR_DCD;
+  case UART_SCR:
+    return u->scr;
+  }
+  return 0xff;
+}
+
+void uart_write(struct uart *u, int reg, int val)
+{
+  val &= 0xff;
+  if (u->lcr & UART_LCR_DLAB) {
+    if (reg == UART_DLL) {
+      u->dll = val;
+      return;
+    }
+    if (reg == UART_DLM) {
+      u->dlm = val;
+      return;
+    }
+  }
+  switch (reg) {
+  case UART_TX:
+    u->thre_int = 0;
+    if (u->txcount == depth(u)) {
+      u->overruns++;		/* the driver should have checked THRE */
+      return;
+    }
+    u->txf[(u->txhead + u->txcount++) % UART_FIFOLEN] = val;
+    if (!u->tsr_busy && u->load_at == SIM_NEVER)
+      u->load_at = sim_now + bit_ns(u);
+    break;
+  case UART_IER:
+    if ((val & UART_IER_THRI) && !(u->ier & UART_IER_THRI) &&
+	u->txcount == 0)
+      u->thre_int = 1;
+    u->ier = val & 0x0f;
+    break;
+  case UART_FCR:
+    if ((val ^ u->fcr) & UART_FCR_ENABLE_FIFO)
+      val |= UART_FCR_CLEAR_RCVR | UART_FCR_CLEAR_XMIT;
+    if (val & UART_FCR_CLEAR_RCVR)
+      u->rxhead = u->rxcount = 0;
+    if (val & UART_FCR_CLEAR_XMIT)
+      u->txhead = u->txcount = 0;
+    u->fcr = val & (UART_FCR_ENABLE_FIFO | UART_FCR_TRIGGER_MASK);
+    break;
+  case UART_LCR:
+    u->lcr = val;
+    break;
+  case UART_MCR:
+    if (CTS_UP(u->mcr) && !CTS_UP(val))
+      u->cts_off = sim_now;
+    else if (!CTS_UP(u->mcr) && CTS_UP(val) && u->send_next < sim_now)
+      u->send_next = sim_now + uart_char_ns(u); /* starts one now */
+    u->mcr = val & 0x1f;
+    break;
+  case UART_SCR:
+    u->scr = val;
+    break;
+  }
+}
+
+/*====================================================================
+*       time
+====================================================================*/
+
+simtime uart_next_event(struct uart *u)
+{
+  simtime t = SIM_NEVER, timeout;
+
+  if (u->load_at < t)
+    t = u->load_at;
+  if (u->tsr_busy && u->tsr_done < t)
+    t = u->tsr_done;
+  if (far_sends(u) && u->send_next < t)
+    t = u->send_next;
+  if ((u->fcr & UART_FCR_ENABLE_FIFO) && u->rxcount) {
+    timeout = u->rx_touch + 4 * uart_char_ns(u);
+    if (timeout > sim_now && timeout < t)
+      t = timeout;
+  }
+  return t;
+}
+
+void uart_run(struct uart *u)
+{
+  if (u->tsr_busy && u->tsr_done <= sim_now) {
+    u->tsr_busy = 0;
+    tx_out(u, u->tsr_ch);
+    if (u->txcount)		/* back to back: no gap */
+      load_tsr(u);
+  }
+  if (u->load_at <= sim_now) {
+    u->load_at = SIM_NEVER;
+    load_tsr(u);
+  }
+  while (far_sends(u) && u->send_next <= sim_now) {
+    if (!(u->mcr & UART_MCR_LOOP)) /* loopback cuts off the line */
+      rx_in(u, u->send[u->sendpos] & 0xff);
+    u->sendpos++;
+    u->send_next += uart_char_ns(u) + u->gap;
+  }
+}
+
+int uart_intr(struct uart *u)
+{
+  return (iir(u) & UART_IIR_NO_INT) == 0;
+}
+
+simtime uart_char_ns(struct uart *u)
+{
+  return char_bits(u) * bit_ns(u);
+}
+
+/*====================================================================
+*       internals
+====================================================================*/
+
+/* the far end has a char coming: it does hardware flow control,
+ * starting one only while it sees CTS, i.e. our RTS (loopback cuts
+ * the line off anyway), and finishing one it had started */
+static int far_sends(struct uart *u)
+{
+  return u->sendpos < u->sendlen && (CTS_UP(u->mcr) ||
+	 u->send_next - uart_char_ns(u) < u->cts_off);
+}
+
+static void rx_in(struct uart *u, int ch)
+{
+  if (u->rxcount == depth(u)) {
+    u->oe = 1;
+    u->overruns++;
+    return;
+  }
+  u->rxf[(u->rxhead + u->rxcount++) % UART_FIFOLEN] = ch;
+  u->rx_touch = sim_now;
+}
+
+/* a char has left the shift register */
+static void tx_out(struct uart *u, int ch)
+{
+  if (u->mcr & UART_MCR_LOOP) {
+    rx_in(u, ch);
+    return;
+  }
+  if (u->recvlen < LINEBUF)
+    u->recv[u->recvlen++] = ch;
+  u->recv_last = sim_now;
+  if (u->peer)
+    u->peer(ch);
+}
+
+static void load_tsr(struct uart *u)
+{
+  if (u->txcount == 0)
+    return;
+  u->tsr_ch = u->txf[u->txhead];
+  u->txhead = (u->txhead + 1) % UART_FIFOLEN;
+  u->txcount--;
+  u->tsr_busy = 1;
+  u->tsr_done = sim_now + uart_char_ns(u);
+  if (u->txcount == 0)
+    u->thre_int = 1;
+}
+
+static int iir(struct uart *u)
+{
+  static int trigger[4] = {1, 4, 8, 14};
+  int fifo = u->fcr & UART_FCR_ENABLE_FIFO;
+
+  if ((u->ier & UART_IER_RLSI) && u->oe)
+    return UART_IIR_RLSI;
+  if (u->ier & UART_IER_RDI) {
+    if (u->rxcount >= (fifo ? trigger[u->fcr >> 6] : 1))
+      return UART_IIR_RDI;
+    if (fifo && u->rxcount &&
+	sim_now >= u->rx_touch + 4 * uart_char_ns(u))
+      return UART_IIR_TIMEOUT;
+  }
+  if ((u->ier & UART_IER_THRI) && u->thre_int)
+    return UART_IIR_THRI;
+  return UART_IIR_NO_INT;
+}
+
+static int depth(struct uart *u)
+{
+  return u->fcr & UART_FCR_ENABLE_FIFO ? UART_FIFOLEN : 1;
+}
+
+static simtime bit_ns(struct uart *u)
+{
+  int divisor = u->dlm << 8 | u->dll;
+
+  if (divisor == 0)
+    divisor = 0x10000;
+  return (simtime)divisor * 16 * 1000000000ULL / UART_XTAL;
+}
+
+/* start, data, parity, stop */
+static int char_bits(struct uart *u)
+{
+  return 1 + 5 + (u->lcr & UART_LCR_WLEN_MASK) +
+    (u->lcr & UART_LCR_PARITY ? 1 : 0) + (u->lcr & UART_LCR_STOP ? 2 : 1);
+}
@@ -0,0 +1,71 @@
+/*********************************************************************
+*
+*       file:           uart.h
+*       author:         paul cardoos
+*
+*       16550A model for the simulator: register interface, 16-byte
+*       FIFOs with trigger level and char timeout, shift-register
+*       timing from the divisor latch and line format, and a far end
+*       ("line") that sends from a buffer and records what it gets,
+*       pausing while RTS is down
+*
+*/
+
+#ifndef UART_H
+#define UART_H
+
+#include "sim.h"
+
+#define UART_FIFOLEN 16
+#define UART_XTAL 1843200	/* baud = UART_XTAL / 16 / divisor */
+#define LINEBUF 65536		/* far end receive buffer */
+
+struct uart {
+  int base;			/* i/o port */
+  int irq;
+  int irqline;			/* INTR output, for edge detection */
+
+  /* registers, as last written */
+  int ier, lcr, mcr, fcr, scr, dll, dlm;
+
+  /* receiver */
+  unsigned char rxf[UART_FIFOLEN];
+  int rxhead, rxcount;
+  int oe;			/* overrun, until LSR is read */
+  simtime rx_touch;		/* last char in or out, for the timeout */
+
+  /* transmitter: FIFO, then shift register */
+  unsigned char txf[UART_FIFOLEN];
+  int txhead, txcount;
+  simtime load_at;		/* FIFO to shift register, or SIM_NEVER */
+  int tsr_busy;
+  int tsr_ch;
+  simtime tsr_done;		/* last stop bit out */
+  int thre_int;			/* THRE interrupt pending */
+
+  /* far end of the line */
+  char *send;			/* chars to send us */
+  int sendlen, sendpos;
+  simtime gap;			/* idle time between them */
+  simtime send_next;		/* when the next one has arrived */
+  simtime cts_off;		/* when RTS last went down */
+  char recv[LINEBUF];		/* what we sent it */
+  int recvlen;
+  simtime recv_last;
+  void (*peer)(int ch);		/* told each char we send it, or 0 */
+
+  unsigned int overruns;	/* chars lost to a full rx FIFO */
+};
+
+void uart_reset(struct uart *u, int base, int irq, int baud);
+int uart_read(struct uart *u, int reg);
+void uart_write(struct uart *u, int reg, int val);
+/* when something next changes by itself, or SIM_NEVER */
+simtime uart_next_event(struct uart *u);
+/* do what is due at sim_now */
+void uart_run(struct uart *u);
+/* INTR output level */
+int uart_intr(struct uart *u);
+simtime uart_char_ns(struct uart *u);
+
+#endif
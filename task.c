@@ -0,0 +1,224 @@
+/*********************************************************************
+*
+*       file:           task.c
+*       author:         paul cardoos
+*
+*       cooperative task scheduler for SAPC
+*
+*       All list manipulation is done with interrupts off, since
+*       interrupt handlers call task_wakeup.  A switch happens only
+*       inside task_sleep/task_yield/task_exit, on the caller's
+*       request, so no task is ever switched out in the middle of
+*       driver code.
+*
+*       When every task is blocked the CPU halts in cpu_idle, which
+*       keeps count of the cycles spent there for PIT0's LOADCONTROL.
+*
+*/
+#include <cpu.h>
+#include "task.h"
+#include "tsc.h"
+
+struct task tasktab[NTASKS] = {{0, TASK_RUNNING}}; /* 0: main program */
+static int stacks[NTASKS][TASKSTACK/sizeof(int)]; /* [0] unused */
+
+static struct task *current = &tasktab[0];
+static struct waitq ready;	/* runnable tasks, not counting current */
+static unsigned long long idle_cycles; /* spent halted in cpu_idle */
+static unsigned long long idle_start;
+static int idling;		/* halted, no handler has run yet */
+
+/* in taskswitch.s */
+extern void task_switch(int **save_sp, int *new_sp);
+
+#ifdef SIM
+void sim_idle(void);		/* runs virtual time to the next event */
+#endif
+
+static void schedule(void);
+static void task_start(void);
+static void put(struct waitq *wq, struct task *t);
+static struct task *get(struct waitq *wq);
+
+/*====================================================================
+*       task creation and exit
+====================================================================*/
+
+int task_create(void (*fn)(int arg), int arg)
+{
+  int id, saved_eflags;
+  int *sp;
+  struct task *t;
+
+  saved_eflags = get_eflags();
+  cli();
+  for (id = 1; id < NTASKS; id++)
+    if (tasktab[id].state == TASK_FREE || tasktab[id].state == TASK_DONE)
+      break;
+  if (id == NTASKS) {
+    set_eflags(saved_eflags);
+    return -1;
+  }
+  t = &tasktab[id];
+  t->fn = fn;
+  t->arg = arg;
+  t->joiners.head = t->joiners.tail = 0;
+
+  /* build the frame task_switch pops: edi, esi, ebx, ebp, then
+   * return into task_start (whose own return address is never used) */
+  sp = &stacks[id][TASKSTACK/sizeof(int)];
+  *--sp = 0;
+  *--sp = (int)task_start;
+  sp -= 4;
+  t->sp = sp;
+
+  t->state = TASK_READY;
+  put(&ready, t);
+  set_eflags(saved_eflags);
+  return id;
+}
+
+/* first code run by a new task, off task_switch's ret */
+static void task_start(void)
+{
+  sti();			/* tasks run with interrupts on */
+  current->fn(current->arg);
+  task_exit();
+}
+
+void task_exit(void)
+{
+  cli();
+  current->state = TASK_DONE;
+  task_wakeup(&current->joiners);
+  schedule();			/* never comes back */
+}
+
+void task_join(int id)
+{
+  int saved_eflags;
+  struct task *t = &tasktab[id];
+
+  saved_eflags = get_eflags();
+  cli();
+  while (t->state != TASK_DONE && t->state != TASK_FREE)
+    task_sleep(&t->joiners);
+  set_eflags(saved_eflags);
+}
+
+/*====================================================================
+*       blocking and waking
+====================================================================*/
+
+void task_yield(void)
+{
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  if (ready.head) {
+    current->state = TASK_READY;
+    put(&ready, current);
+    schedule();
+  }
+  set_eflags(saved_eflags);
+}
+
+/* caller has ints off, and rechecks its condition after we return */
+void task_sleep(struct waitq *wq)
+{
+  current->state = TASK_BLOCKED;
+  put(wq, current);
+  schedule();
+}
+
+void task_wakeup(struct waitq *wq)
+{
+  struct task *t;
+
+  while ((t = get(wq)) != 0) {
+    t->state = TASK_READY;
+    put(&ready, t);
+  }
+}
+
+/* run the next ready task, waiting with ints on if there is none;
+ * current has already been put wherever it belongs */
+static void schedule(void)
+{
+  struct task *prev = current;
+
+  while (ready.head == 0)	/* everyone is blocked: let ISRs run */
+    cpu_idle();
+  current = get(&ready);
+  current->state = TASK_RUNNING;
+  if (current != prev)
+    task_switch(&prev->sp, current->sp);
+}
+
+/*====================================================================
+*       idling
+====================================================================*/
+
+/* sti holds off interrupts until after the next instruction, so one
+ * arriving before the hlt still ends it, instead of being missed
+ * until the one after. */
+void cpu_idle(void)
+{
+  idle_start = rdtsc();
+  idling = 1;
+#ifdef SIM
+  sim_idle();
+#else
+  __asm__ __volatile__("sti; hlt");
+#endif
+  cli();
+  cpu_wake();			/* in case the handler didn't */
+}
+
+/* called with ints off */
+void cpu_wake(void)
+{
+  if (idling) {
+    idle_cycles += rdtsc() - idle_start;
+    idling = 0;
+  }
+}
+
+unsigned long long cpu_idle_cycles(void)
+{
+  unsigned long long n;
+  int saved_eflags;
+
+  saved_eflags = get_eflags();
+  cli();
+  n = idle_cycles;
+  set_eflags(saved_eflags);
+  return n;
+}
+
+/*====================================================================
+*       fifo lists of tasks
+====================================================================*/
+
+static void put(struct waitq *wq, struct task *t)
+{
+  t->next = 0;
+  if (wq->tail)
+    wq->tail->next = t;
+  else
+    wq->head = t;
+  wq->tail = t;
+}
+
+static struct task *get(struct waitq *wq)
+{
+  struct task *t = wq->head;
+
+  if (t) {
+    wq->head = t->next;
+    if (wq->head == 0)
+      wq->tail = 0;
+  }
+  return t;
+}
@@ -0,0 +1,65 @@
+/*********************************************************************
+*
+*       file:           task.h
+*       author:         paul cardoos
+*
+*       cooperative task scheduler: a task runs until it blocks in
+*       a wait queue (e.g. in read or write) or calls task_yield.
+*       Interrupt handlers wake tasks but never switch them.
+*
+*/
+
+#ifndef TASK_H
+#define TASK_H
+
+#define NTASKS 4		/* including main, which is task 0 */
+#define TASKSTACK 8192		/* bytes of stack per created task */
+
+/* task states */
+#define TASK_FREE 0
+#define TASK_READY 1
+#define TASK_RUNNING 2
+#define TASK_BLOCKED 3
+#define TASK_DONE 4
+
+/* tasks blocked on some event, e.g. input arriving */
+struct waitq {
+  struct task *head;
+  struct task *tail;
+};
+
+struct task {
+  int *sp;			/* saved stack pointer while switched out */
+  int state;
+  struct task *next;		/* link in ready list or a wait queue */
+  void (*fn)(int arg);		/* body of a created task */
+  int arg;
+  struct waitq joiners;		/* tasks waiting for this one to end */
+};
+
+extern struct task tasktab[];
+
+/* start fn(arg) as a new task; returns task id, or -1 if none free */
+int task_create(void (*fn)(int arg), int arg);
+/* let other ready tasks run */
+void task_yield(void);
+/* end the calling task (also done when its fn returns) */
+void task_exit(void);
+/* wait for task id to finish */
+void task_join(int id);
+
+/* block the caller on wq until task_wakeup; call with ints off */
+void task_sleep(struct waitq *wq);
+/* make every task on wq ready; ok from interrupt handlers */
+void task_wakeup(struct waitq *wq);
+
+/* halt until an interrupt has been handled, counting the time as
+   idle; call with ints off, returns with them off */
+void cpu_idle(void);
+/* first thing in an interrupt handler: stop counting idle time, so
+   the handler counts as busy */
+void cpu_wake(void);
+/* TSC cycles spent in cpu_idle since boot */
+unsigned long long cpu_idle_cycles(void);
+
+#endif
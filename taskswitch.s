@@ -0,0 +1,24 @@
+# file:   taskswitch.s
+# author: paul cardoos
+#
+# void task_switch(int **save_sp, int *new_sp)
+# Save the C callee-saved registers on the current stack, store the
+# stack pointer in *save_sp, then load new_sp and return on the other
+# task's stack.  Called with interrupts off.
+
+	.text
+	.globl task_switch
+task_switch:
+	movl 4(%esp), %eax	# where to save our sp
+	movl 8(%esp), %edx	# sp to switch to
+	pushl %ebp
+	pushl %ebx
+	pushl %esi
+	pushl %edi
+	movl %esp, (%eax)
+	movl %edx, %esp
+	popl %edi
+	popl %esi
+	popl %ebx
+	popl %ebp
+	ret
@@ -8,13 +8,15 @@
 *
 *       Modified by Ron Cheung on 9/2016 to have a bigger
 *       DELAYLOOPCOUNT for faster VM
+*       delay() now sleeps on the PIT timer instead of counting
+*       klogf after ioinit: no delays needed to keep output in order
 */
 
 #include <stdio.h>              /* for lib's device # defs, protos */
 #include "io_public.h"		/* for our packages devs, API prototypes */
+#include "klog.h"
 
-#define MILLION 1000000
-#define DELAYLOOPCOUNT (1000000000)
+#define DELAYTICKS (2*HZ)	/* 2 seconds */
 #define BUFLEN 80
 
 //extern int kprintf(char * format, ...);
@@ -22,7 +24,8 @@ void delay(void);
 /* Note that kprintf is supplied with the SAPC support library.  It does 
   output polling to the console device with interrupts (temporarily) off.
   We are using it as a debugging tool while working with a development
-  system, especially one using interrupts.  */
+  system, especially one using interrupts.  After ioinit we use klogf,
+  which queues its output behind ours instead of polling. */
 
 int main(void)
 {
@@ -43,54 +46,50 @@ int main(void)
   /* Now have a usable device to talk to with i/o package-- */
 
   ioinit();  /* Initialize devices */
-  kprintf("\nTrying simple write(4 chars)...\n");
+  klog_init(ldev);  /* diagnostics from here on go with our output */
+  klogf("\nTrying simple write(4 chars)...\n");
   got = write(ldev,"hi!\n",4);
-  kprintf("write of 4 returned %d\n",got);
-  delay();  /* time for output to finish, once write-behind is working */
+  klogf("write of 4 returned %d\n",got);
 
-  kprintf("Trying longer write (9 chars)\n");
+  klogf("Trying longer write (9 chars)\n");
   got = write(ldev, "abcdefghi", 9);
-  kprintf("write of 9 returned %d\n",got);
-  delay();  /* time for output to finish, once write-behind is working */
+  klogf("write of 9 returned %d\n",got);
 
   for (i = 0; i < BUFLEN; i++)
       buf[i] = 'A'+ i/2;
-  kprintf("\nTrying write of %d-char string...\n", BUFLEN);
+  klogf("\nTrying write of %d-char string...\n", BUFLEN);
   got = write(ldev, buf, BUFLEN);
-  kprintf("\nwrite returned %d\n", got);
-  delay();
+  klogf("\nwrite returned %d\n", got);
 
-  kprintf("\nType 10 chars input to test typeahead while looping for delay...\n");
+  klogf("\nType 10 chars input to test typeahead while looping for delay...\n");
   delay();
   got = read(ldev, buf, 10);	/* should wait for all 10 chars, once fixed */
-  kprintf("\nGot %d chars into buf. Trying write of buf...\n", got);
+  klogf("\nGot %d chars into buf. Trying write of buf...\n", got);
   write(ldev, buf, got);
 
-  kprintf("\nTrying another 10 chars read right away...\n");
+  klogf("\nTrying another 10 chars read right away...\n");
   got = read(ldev, buf, 10);	/* should wait for input, once fixed */
-  kprintf("\nGot %d chars on second read\n",got);
+  klogf("\nGot %d chars on second read\n",got);
   if (got == 0) 
-      kprintf("nothing in buffer\n");	/* expected result until fixed */
+      klogf("nothing in buffer\n");	/* expected result until fixed */
   else 
       write(ldev, buf, got);	/* should write 10 chars once fixed */
 
-  kprintf("\n\nNow turning echo off--\n");
+  klogf("\n\nNow turning echo off--\n");
   control(ldev, ECHOCONTROL, 0);
-  kprintf("\nType 20 chars input, note lack of echoes...\n");
+  klogf("\nType 20 chars input, note lack of echoes...\n");
   delay();
   got = read(ldev, buf, 20);
-  kprintf("\nTrying write of buf...\n");
+  klogf("\nTrying write of buf...\n");
   write(ldev, buf, got);
-  kprintf("\nAsked for 20 characters; got %d\n", got);
+  klogf("\nAsked for 20 characters; got %d\n", got);
+  klog_flush();
   return 0;
 }
 
-/* the faster the machine you're on, the longer this loop must be */
+/* wait on the timer, the same on any speed machine */
 void delay()
 {
-  unsigned  long int i;
-
-  kprintf("<doing delay>\n");
-  for (i = 0; i < DELAYLOOPCOUNT; i++)
-   ;
-   }
+  klogf("<doing delay>\n");
+  control(PIT0, SLEEPCONTROL, DELAYTICKS);
+}
@@ -0,0 +1,148 @@
+/*********************************************************************
+*
+*       file:           testpool.c
+*       author:         paul cardoos
+*
+*       driver for the buffer pool (pool.c), native on Linux:
+*       "make testpool && ./testpool"
+*
+*       Takes a pool to empty and back twice, checks frees of
+*       buffers that aren't the pool's, that the change count in
+*       the head wraps, and that a swap based on a stale head fails
+*       even when the same buffer is first again (ABA).  Then two
+*       threads allocate and free at once, standing in for a task
+*       and an ISR.  Exit status is 1 if anything came out wrong.
+*
+*/
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "pool.h"
+
+#define BUFSIZE 32
+#define NBUFS 8
+#define NTHREADS 2
+#define ROUNDS 100000		/* alloc/free pairs per thread */
+
+struct pool pool;
+POOL_STORAGE(pool, BUFSIZE, NBUFS);
+char *got[NBUFS];
+char other[BUFSIZE];		/* a buffer from somewhere else */
+int errors;
+
+void fail(char *what)
+{
+  printf("  FAILED: %s\n", what);
+  errors++;
+}
+
+/* allocate until empty: every buffer once, in the pool, aligned */
+void drain(void)
+{
+  int i, j, off;
+
+  for (i = 0; i < NBUFS; i++) {
+    if ((got[i] = pool_alloc(&pool)) == 0) {
+      fail("pool_alloc returned 0 with buffers free");
+      return;
+    }
+    off = got[i] - pool_mem;
+    if (off < 0 || off >= BUFSIZE * NBUFS || off % BUFSIZE)
+      fail("buffer outside the pool");
+    for (j = 0; j < i; j++)
+      if (got[j] == got[i])
+	fail("buffer handed out twice");
+  }
+  if (pool_alloc(&pool) != 0)
+    fail("pool_alloc on an empty pool");
+}
+
+void *churn(void *arg)
+{
+  char *b;
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) {
+    while ((b = pool_alloc(&pool)) == 0)
+      sched_yield();		/* the other one has them all */
+    b[0] = (char)(long)arg;	/* ours alone until freed */
+    if ((i & 63) == 0)
+      sched_yield();
+    if (b[0] != (char)(long)arg)
+      fail("buffer shared between threads");
+    pool_free(&pool, b);
+  }
+  return 0;
+}
+
+int main(void)
+{
+  unsigned long long old, mid;
+  pthread_t t[NTHREADS];
+  char *a;
+  int i, pass;
+
+  printf("pool_init with no buffers, then %d of %d bytes\n", NBUFS, BUFSIZE);
+  if (pool_init(&pool, pool_mem, pool_links, BUFSIZE, 0) != -1)
+    fail("pool_init took nbufs 0");
+  pool_init(&pool, pool_mem, pool_links, BUFSIZE, NBUFS);
+
+  for (pass = 1; pass <= 2; pass++) {
+    printf("pass %d: allocate all, then free all\n", pass);
+    drain();
+    if (pool.inuse != NBUFS || pool.highwater != NBUFS)
+      fail("inuse or highwater wrong when empty");
+    for (i = 0; i < NBUFS; i++)
+      if (pool_free(&pool, got[i]) != 0)
+	fail("pool_free refused a pool buffer");
+    if (pool.inuse != 0)
+      fail("inuse not 0 after freeing all");
+  }
+  printf("allocs %u, fails %u\n", pool.allocs, pool.fails);
+  if (pool.allocs != 2 * NBUFS || pool.fails != 2)
+    fail("counters wrong");
+
+  printf("free buffers that aren't the pool's\n");
+  if (pool_free(&pool, pool_mem + 1) != -1)
+    fail("pool_free took a pointer into a buffer");
+  if (pool_free(&pool, pool_mem + BUFSIZE * NBUFS) != -1)
+    fail("pool_free took a pointer past the pool");
+  if (pool_free(&pool, other) != -1)
+    fail("pool_free took another buffer");
+
+  printf("change count wraps from 0xffffffff\n");
+  pool.head = 0xffffffffULL << 32 | (unsigned int)pool.head;
+  a = pool_alloc(&pool);
+  if (pool.head >> 32 != 0)
+    fail("count didn't wrap to 0");
+  pool_free(&pool, a);
+  if (pool.head >> 32 != 1 || (char *)pool_alloc(&pool) != a)
+    fail("pool wrong after the wrap");
+  pool_free(&pool, a);
+
+  printf("stale head: alloc A, alloc B, free A puts A first again\n");
+  old = pool.head;
+  a = pool_alloc(&pool);
+  pool_alloc(&pool);
+  pool_free(&pool, a);
+  mid = pool.head;
+  if ((unsigned int)mid != (unsigned int)old)
+    fail("A not first again");
+  if (__sync_bool_compare_and_swap(&pool.head, old, old + 1))
+    fail("swap on a stale head succeeded");
+  if (mid >> 32 != (old >> 32) + 3)
+    fail("count didn't go up once per change");
+
+  printf("%d threads, %d alloc/free pairs each\n", NTHREADS, ROUNDS);
+  pool_init(&pool, pool_mem, pool_links, BUFSIZE, NBUFS);
+  for (i = 0; i < NTHREADS; i++)
+    pthread_create(&t[i], 0, churn, (void *)(long)(i + 1));
+  for (i = 0; i < NTHREADS; i++)
+    pthread_join(t[i], 0);
+  if (pool.inuse != 0)
+    fail("inuse not 0 after the threads");
+  drain();			/* none lost or doubled */
+
+  printf(errors ? "%d FAILED\n" : "all passed\n", errors);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+/*********************************************************************
+*
+*       file:           tsc.h
+*       author:         paul cardoos
+*
+*       Time stamp counter (rdtsc, Pentium and later) access for
+*       timing code, usable in both SAPC and UNIX host builds.
+*
+*       The SAPC is linked without libgcc, so 64-bit division
+*       (__udivdi3) is not available there: use div64_32 instead.
+*
+*       In the simulator build (-DSIM) the counter is the virtual
+*       clock's, so driver timings come out in simulated cycles.
+*
+*/
+
+#ifndef TSC_H
+#define TSC_H
+
+/* read the CPU cycle counter */
+#ifdef SIM
+unsigned long long sim_rdtsc(void);
+
+static inline unsigned long long rdtsc(void)
+{
+  return sim_rdtsc();
+}
+#else
+static inline unsigned long long rdtsc(void)
+{
+  unsigned int lo, hi;
+
+  __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long)hi << 32) | lo;
+}
+#endif
+
+/* 64-by-32 bit unsigned divide, saturating if the quotient won't fit */
+static inline unsigned int div64_32(unsigned long long n, unsigned int d)
+{
+#ifdef SAPC
+  unsigned int q, r;
+
+  if (d == 0 || (unsigned int)(n >> 32) >= d)
+    return 0xffffffff;		/* divl would fault */
+  __asm__("divl %4" : "=a" (q), "=d" (r)
+	  : "a" ((unsigned int)n), "d" ((unsigned int)(n >> 32)), "rm" (d));
+  return q;
+#else
+  if (d == 0 || n / d > 0xffffffffULL)
+    return 0xffffffff;
+  return (unsigned int)(n / d);
+#endif
+}
+
+#endif
@@ -9,6 +9,19 @@
 *
 *       2/24/2021 - implemented writes with interrupts
 *                 - implemented read/writes with queues
+*       queues per device, transmitter kept armed while output is
+*       queued, counters for benchmarking (STATSCONTROL)
+*       blocked read/write sleep so other tasks can run; a write
+*       that sleeps keeps others out of outq until it is all in
+*       SLIP/COBS framing mode, decoded in the ISR (FRAMECONTROL)
+*       running CRC-16/CRC-32 of data read and written (CRCCONTROL)
+*       negotiated LZ compression of the byte stream (LZCONTROL)
+*       split ISR: the hard part only empties/fills the UART FIFOs,
+*       echo, framing and wakeups run later with ints on (tty_bh)
+*       sends the klog ring, in order with writes (tty_attach_log),
+*       held while framing or LZ is on
+*       records input events, replays them through tty_bh
+*       input translation and class tables, one lookup each per char
 *
 */
 #include <stdio.h>  /* for kprintf prototype */
@@ -18,21 +31,26 @@
 #include "ioconf.h"
 #include "tty_public.h"
 #include "tty.h"
+#include "io_public.h"	/* struct iobuf */
 #include "queue/queue.h" /* import queue data structure */
+#include "tsc.h"
 
 struct tty ttytab[NTTYS];        /* software params/data for each SLU dev */
 
 /* Record debug info in otherwise free memory between program and stack */
 /* 0x300000 = 3M, the start of the last M of user memory on the SAPC */
 #define DEBUG_AREA 0x300000
+#define DEBUG_AREA_SIZE 0x100000 /* log wraps around at the end of memory */
 #define BUFLEN 20
 
+#ifdef SIM
+static char debug_area[DEBUG_AREA_SIZE]; /* no fixed address on the host */
+char *debug_log_area = debug_area;
+#else
 char *debug_log_area = (char *)DEBUG_AREA;
+#endif
 char *debug_record;  /* current pointer into log area */
 
-/* declare queues*/
-Queue inQueue, outQueue, echoQueue;
-
 /* tell C about the assembler shell routines */
 extern void irq3inthand(void), irq4inthand(void);
 
@@ -42,6 +60,80 @@ extern void irq3inthandc(void), irq4inthandc(void);
 /* the common code for the two interrupt handlers */
 static void irqinthandc(int dev);
 
+/* deferred part of the interrupt handlers, for both ports */
+static void tty_bh(void);
+static int bh_running;		/* tty_bh is active, maybe interrupted */
+static int bh_timer;		/* a PIT timer fed raw: see tty_timer_bh */
+static void run_bh(void);
+
+/* hard ISR parts, shared with replay */
+static void count_iir(struct tty *tty, int iir);
+static void rx_raw(struct tty *tty, int ch);
+
+/* record/replay of input events */
+static struct recorder rec;
+static struct replayer play;
+static void record(struct tty *tty, int type, int data);
+static void replay_tick(void *arg);
+
+/* start transmitter if it is idle and there is output pending */
+static void kick_tx(int baseport, struct tty *tty);
+
+/* the klog ring to send, or 0: none, or held while the stream is
+ * framed or compressed, where log text would corrupt it */
+static Queue *log_out(struct tty *tty);
+
+/* zero the struct ttystats counters */
+static void clear_stats(struct tty *tty);
+
+/* install a translation or class table: identity/plain if src is 0 */
+static void set_table(unsigned char *table, char *src, int identity);
+
+/* chained output: add a chain, and let go of the sent first buffer */
+static int write_chain(struct tty *tty, struct iobuf *chain);
+static void chain_release(struct tty *tty);
+
+/* queue watermark functions: RTS from inq's, writers from outq's */
+static void inq_mark(Queue *q, int which, void *arg);
+static void outq_mark(Queue *q, int which, void *arg);
+static void set_rts(struct tty *tty, int on);
+
+/* queue one output char, waiting for room (frame_tx put function) */
+static void tx_put(void *arg, int ch);
+
+/* one write's chars at a time into outq, even when tx_put sleeps, so
+ * frames from different tasks don't interleave; called with ints off */
+static void write_lock(struct tty *tty);
+static void write_unlock(struct tty *tty);
+
+/* framing mode: decode a received char, queue the frame when complete */
+static void rx_frame(struct tty *tty, int ch);
+
+/* framing mode read: one frame */
+static int read_frame(struct tty *tty, char *buf, int nchar);
+
+/* discard unread input, sizing inq for the framing mode */
+static void flush_input(struct tty *tty);
+
+/* read through a delimiter, a span at a time */
+static int read_until(struct tty *tty, char *buf, int max, int delim);
+
+/* timestamped read: chars and their readts times */
+static int read_ts(struct tty *tty, char *buf, unsigned short *ts,
+		   int nchar);
+
+/* compressed mode read: decompress into buf */
+static int read_lz(struct tty *tty, char *buf, int nchar);
+/* lz_ready input: inq's chars, in place */
+static int inq_peek(void *arg, int k);
+
+/* exchange LZHELLO with the other end, then compress */
+static int lz_negotiate(struct tty *tty);
+
+/* fold n chars of buf into a running CRC */
+static unsigned int crc_add(struct tty *tty, unsigned int crc,
+			    char *buf, int n);
+
 /* prototype for debug_log */
 void debug_log(char *);
 
@@ -54,14 +146,33 @@ void ttyinit(int dev)
   int baseport;
   struct tty *tty;		/* ptr to tty software params/data block */
 
-  /* Initialize queues */
-  init_queue(&inQueue, MAXBUF);
-  init_queue(&outQueue, MAXBUF);
-  init_queue(&echoQueue, MAXBUF);
-
   debug_record = debug_log_area; /* clear debug log */
   baseport = devtab[dev].dvbaseport; /* pick up hardware addr */
   tty = (struct tty *)devtab[dev].dvdata; /* and software params struct */
+  tty->baseport = baseport;
+  tty->framing = FRAME_NONE;
+  tty->crcmode = CRC_NONE;
+  tty->lz = tty->lzhello = 0;
+  tty->logq = 0;
+  tty->txchain = tty->txlast = 0;
+  tty->flow = 0;
+  tty->tsmode = 0;
+  tty->acquired = 0;
+  set_table(tty->xlate, 0, 1);
+  set_table(tty->cclass, 0, 0);
+  crc_init();
+
+  /* Initialize queues */
+  flush_input(tty);
+  init_queue(&tty->outq, MAXBUF);
+  /* writers wait for a full outq to drain halfway, then refill it */
+  queue_watermarks(&tty->outq, MAXBUF, MAXBUF / 2, outq_mark, tty);
+  init_queue_mode(&tty->echoq, MAXBUF, QUEUE_OVERWRITE); /* latest wins */
+  clear_stats(tty);
+  tty->readers.head = tty->readers.tail = 0;
+  tty->writers.head = tty->writers.tail = 0;
+  tty->wlock = 0;
+  tty->wlockq.head = tty->wlockq.tail = 0;
 
   if (baseport == COM1_BASE) {
       /* arm interrupts by installing int vec */
@@ -77,6 +188,10 @@ void ttyinit(int dev)
   }
   tty->echoflag = 1;		/* default to echoing */
 
+  /* 16550 FIFOs: an rx interrupt per 8 chars (or a pause) */
+  outpt(baseport+UART_FCR, UART_FCR_ENABLE_FIFO | UART_FCR_CLEAR_RCVR |
+	UART_FCR_CLEAR_XMIT | UART_FCR_TRIGGER_8);
+
   /* enable interrupts on receiver */
   outpt(baseport+UART_IER, UART_IER_RDI); /* RDI = receiver data int */
 }
@@ -88,22 +203,33 @@ void ttyinit(int dev)
 int ttyread(int dev, char *buf, int nchar)
 {
   int ch, saved_eflags, i;
+  unsigned long long wait_start;
   char log[BUFLEN];
+  struct tty *tty = (struct tty *)devtab[dev].dvdata;
 
+  if (tty->framing)
+    return read_frame(tty, buf, nchar);
+  if (tty->lz)
+    return read_lz(tty, buf, nchar);
   i = 0;
 
+  saved_eflags = get_eflags();
+  cli();			                   /* disable ints in CPU */
   while (i < nchar) {
     /* Loop indefinetely until nchar are entered in */
-    saved_eflags = get_eflags();
-    cli();			                   /* disable ints in CPU */
-    if((ch = dequeue(&inQueue)) != EMPTYQUE){
+    if((ch = dequeue(&tty->inq)) != EMPTYQUE){
       buf[i] = ch;
       sprintf(log, ">%c", buf[i]); /* record input char-- */
       debug_log(log);
       i++;
+    } else {
+      wait_start = rdtsc();
+      task_sleep(&tty->readers);   /* ISR wakes us on input */
+      tty->stats.waitcycles += rdtsc() - wait_start;
     }
-    set_eflags(saved_eflags);     /* back to previous CPU int. status */
   }
+  tty->crc.rx = crc_add(tty, tty->crc.rx, buf, nchar);
+  set_eflags(saved_eflags);     /* back to previous CPU int. status */
   return nchar;
 }
 
@@ -118,26 +244,62 @@ int ttyread(int dev, char *buf, int nchar)
 
 int ttywrite(int dev, char *buf, int nchar)
 {
-  int baseport, i;
+  int i, saved_eflags;
   char log[BUFLEN];
+  struct tty *tty = (struct tty *)devtab[dev].dvdata;
+  Queue *logq;
 
-  baseport = devtab[dev].dvbaseport; /* hardware addr from devtab */
-  i = 0;
-
-  cli();
-  while (i < nchar) {
-    if(enqueue(&outQueue, buf[i]) != FULLQUE){
-        outpt(baseport+UART_IER, UART_IER_THRI);
-        /* kick start TX interrupt */
-        sprintf(log,"<%c", buf[i]); /* record input char-- */
-        debug_log(log);
-        i++;
+  saved_eflags = get_eflags();
+  cli();			/* queue is shared with the ISR */
+  write_lock(tty);
+  while (tty->txchain)		/* after any chained output */
+    task_sleep(&tty->writers);
+  if ((logq = log_out(tty)) != 0) /* what was logged first goes first */
+    while (queuecount(logq))
+      tx_put(tty, dequeue(logq));
+  tty->crc.tx = crc_add(tty, tty->crc.tx, buf, nchar);
+  if (tty->framing)
+    frame_tx(tty->framing, buf, nchar, tx_put, tty); /* one frame */
+  else if (tty->lz)
+    lz_encode(&tty->lzenc, buf, nchar, tx_put, tty);
+  else
+    for (i = 0; i < nchar; i++) {
+      tx_put(tty, buf[i]);
+      sprintf(log,"<%c", buf[i]); /* record input char-- */
+      debug_log(log);
     }
-    sti();
-  }
+  write_unlock(tty);
+  set_eflags(saved_eflags);
   return nchar;
 }
 
+/* called with ints off */
+static void tx_put(void *arg, int ch)
+{
+  struct tty *tty = (struct tty *)arg;
+  unsigned long long wait_start;
+
+  while (enqueue(&tty->outq, ch) == FULLQUE) {
+    wait_start = rdtsc();
+    task_sleep(&tty->writers);	/* ISR wakes us as the queue drains */
+    tty->stats.waitcycles += rdtsc() - wait_start;
+  }
+  kick_tx(tty->baseport, tty);	/* kick start TX interrupt */
+}
+
+static void write_lock(struct tty *tty)
+{
+  while (tty->wlock)
+    task_sleep(&tty->wlockq);
+  tty->wlock = 1;
+}
+
+static void write_unlock(struct tty *tty)
+{
+  tty->wlock = 0;
+  task_wakeup(&tty->wlockq);
+}
+
 /*====================================================================
 *       tty-specific control routine for TTY devices
 ====================================================================*/
@@ -145,10 +307,222 @@ int ttywrite(int dev, char *buf, int nchar)
 int ttycontrol(int dev, int fncode, int val)
 {
   struct tty *this_tty = (struct tty *)(devtab[dev].dvdata);
+  int baseport = devtab[dev].dvbaseport;
+  int saved_eflags, mcr, span;
+  char *from, *to;
+  unsigned int i;
+  struct ioreq *req;
+  Queue *logq;
 
-  if (fncode == ECHOCONTROL)
-    this_tty->echoflag = val;
-  else return -1;
+  switch (fncode) {
+  case ECHOCONTROL:
+    if (this_tty->lz)		/* echoes would garble the stream */
+      this_tty->lzecho = val;
+    else
+      this_tty->echoflag = val;
+    break;
+  case LOOPCONTROL:
+    saved_eflags = get_eflags();
+    cli();			/* tty_bh may set RTS */
+    mcr = inpt(baseport+UART_MCR);
+    if (val)
+      outpt(baseport+UART_MCR, mcr | UART_MCR_LOOP);
+    else
+      outpt(baseport+UART_MCR, mcr & ~UART_MCR_LOOP);
+    set_eflags(saved_eflags);
+    break;
+  case FLOWCONTROL:
+    saved_eflags = get_eflags();
+    cli();
+    this_tty->flow = val;
+    flush_input(this_tty);	/* sets the watermarks, raises RTS */
+    set_eflags(saved_eflags);
+    break;
+  case FLUSHCONTROL:
+    saved_eflags = get_eflags();
+    cli();
+    flush_input(this_tty);
+    set_eflags(saved_eflags);
+    break;
+  case FRAMECONTROL:
+    if (val != FRAME_NONE && val != FRAME_SLIP && val != FRAME_COBS)
+      return -1;
+    if (this_tty->lz)
+      return -1;		/* one or the other */
+    saved_eflags = get_eflags();
+    cli();
+    this_tty->framing = val;
+    flush_input(this_tty);
+    kick_tx(baseport, this_tty); /* the log, if it was held */
+    set_eflags(saved_eflags);
+    break;
+  case CRCCONTROL:
+    if (val != CRC_NONE && val != CRC_16 && val != CRC_32)
+      return -1;
+    this_tty->crcmode = val;
+    /* fall through */
+  case CRCRESET:
+    this_tty->crc.rx = this_tty->crc.tx = 0;
+    break;
+  case CRCGET:
+    ((struct ttycrc *)val)->rx = this_tty->crc.rx;
+    ((struct ttycrc *)val)->tx = this_tty->crc.tx;
+    break;
+  case LZCONTROL:
+    if (val == 0) {
+      saved_eflags = get_eflags();
+      cli();
+      if (this_tty->lz)
+	this_tty->echoflag = this_tty->lzecho;
+      this_tty->lz = 0;
+      kick_tx(baseport, this_tty); /* the log, if it was held */
+      set_eflags(saved_eflags);
+      break;
+    }
+    if (this_tty->framing)
+      return -1;
+    return lz_negotiate(this_tty);
+  case READYCONTROL:
+    /* lets a protocol poll for input between its timeouts */
+    if (this_tty->framing)
+      return rqueuecount(&this_tty->flen);
+    if (this_tty->lz) {		/* decoded chars, not the raw count */
+      saved_eflags = get_eflags();
+      cli();
+      i = lz_ready(&this_tty->lzdec, inq_peek, &this_tty->inq);
+      set_eflags(saved_eflags);
+      return i;
+    }
+    return queuecount(&this_tty->inq);
+  case DRAINCONTROL:
+    /* the ISR empties the queues, then the UART shifts out the last char */
+    saved_eflags = get_eflags();
+    cli();
+    while (queuecount(&this_tty->outq) || queuecount(&this_tty->echoq) ||
+	   this_tty->txchain ||
+	   ((logq = log_out(this_tty)) && queuecount(logq)))
+      task_sleep(&this_tty->writers);
+    set_eflags(saved_eflags);
+    /* at most a char time or two: let other tasks run meanwhile */
+    while (!(inpt(baseport+UART_LSR) & UART_LSR_TEMT))
+      pit_sleep(1);
+    break;
+  case STATSCONTROL:
+    /* byte copy: no memcpy in the SAPC library */
+    saved_eflags = get_eflags();
+    cli();
+    this_tty->stats.echolost = this_tty->echoq.overwritten;
+    from = (char *)&this_tty->stats;
+    to = (char *)val;
+    for (i = 0; i < sizeof(struct ttystats); i++)
+      to[i] = from[i];
+    set_eflags(saved_eflags);
+    break;
+  case STATSRESET:
+    saved_eflags = get_eflags();
+    cli();
+    clear_stats(this_tty);
+    set_eflags(saved_eflags);
+    break;
+  case RECORDCONTROL:
+    saved_eflags = get_eflags();
+    cli();
+    if (val) {
+      rec.n = rec.lost = 0;
+      rec.last = rdtsc();
+      rec.tty = this_tty;
+    } else if (rec.tty == this_tty)
+      rec.tty = 0;
+    set_eflags(saved_eflags);
+    break;
+  case RECGETCONTROL:
+    ((struct ttyrec *)val)->ev = rec.ev;
+    ((struct ttyrec *)val)->n = rec.n;
+    ((struct ttyrec *)val)->lost = rec.lost;
+    break;
+  case REPLAYCONTROL:
+    saved_eflags = get_eflags();
+    cli();
+    if (play.tty) {		/* stop the one running */
+      pit_timer_stop(&play.timer);
+      play.tty = 0;
+    }
+    i = play.n - play.next;
+    if (val) {
+      play.ev = ((struct ttyrec *)val)->ev;
+      play.n = ((struct ttyrec *)val)->n;
+      play.next = 0;
+      play.budget = 0;
+      play.cycles_per_tick = pit_cpu_hz() / HZ;
+      play.timer.ticks = play.timer.period = 1;
+      play.timer.fn = replay_tick;
+      play.timer.arg = 0;
+      play.tty = this_tty;
+      pit_timer_start(&play.timer);
+    }
+    set_eflags(saved_eflags);
+    return val ? 0 : i;
+  case XLATECONTROL:
+    set_table(this_tty->xlate, (char *)val, 1);
+    break;
+  case CLASSCONTROL:
+    set_table(this_tty->cclass, (char *)val, 0);
+    break;
+  case TSCONTROL:
+    /* a char is timed when the ISR takes it, so have the UART
+       interrupt for each one, not once per FIFO load */
+    saved_eflags = get_eflags();
+    cli();
+    this_tty->tsmode = val;
+    this_tty->rxtsc = rdtsc();
+    outpt(baseport+UART_FCR, UART_FCR_ENABLE_FIFO |
+	  (val ? UART_FCR_TRIGGER_1 : UART_FCR_TRIGGER_8));
+    set_eflags(saved_eflags);
+    break;
+  case IOC_ACQUIRE:
+    /* the ISR only fills free slots, so the span stays put until released */
+    if (this_tty->framing || this_tty->lz)
+      return -1;		/* queue doesn't hold what the app reads */
+    req = (struct ioreq *)val;
+    saved_eflags = get_eflags();
+    cli();
+    while ((req->n = queuespan(&this_tty->inq, &req->buf)) == 0)
+      task_sleep(&this_tty->readers);
+    this_tty->acquired = 1;
+    set_eflags(saved_eflags);
+    return req->n;
+  case IOC_READUNTIL:
+    if (this_tty->framing || this_tty->lz)
+      return -1;		/* queue doesn't hold what the app reads */
+    req = (struct ioreq *)val;
+    return req->n = read_until(this_tty, req->buf, req->n, req->arg);
+  case IOC_READTS:
+    if (this_tty->framing || this_tty->lz || !this_tty->tsmode)
+      return -1;
+    req = (struct ioreq *)val;
+    return req->n = read_ts(this_tty, req->buf, req->ts, req->n);
+  case IOC_WRITECHAIN:
+    if (this_tty->framing || this_tty->lz)
+      return -1;		/* the wire doesn't carry the data as is */
+    return write_chain(this_tty, ((struct ioreq *)val)->chain);
+  case IOC_RELEASE:
+    req = (struct ioreq *)val;
+    saved_eflags = get_eflags();
+    cli();
+    if (this_tty->crcmode) {	/* fold in the released chars */
+      span = queuespan(&this_tty->inq, &from);
+      this_tty->crc.rx = crc_add(this_tty, this_tty->crc.rx, from,
+				 req->n < span ? req->n : span);
+    }
+    req->n = queueskip(&this_tty->inq, req->n);
+    if (this_tty->killed > req->n)	/* the rest of a kill */
+      queueskip(&this_tty->inq, this_tty->killed - req->n);
+    this_tty->acquired = this_tty->killed = 0;
+    set_eflags(saved_eflags);
+    return req->n;
+  default:
+    return -1;
+  }
   return 0;
 }
 
@@ -170,41 +544,593 @@ void irq3inthandc()
   irqinthandc(TTY1);
 }
 
+/* The hard part: move chars between the UART and the rings, ints
+ * off, then have tty_bh do the rest. */
 void irqinthandc(int dev){
   int ch, baseport, iir;
 
   struct tty *tty = (struct tty *)(devtab[dev].dvdata);
 
+  cpu_wake();			/* the rest is busy time */
   baseport = devtab[dev].dvbaseport; /* hardware i/o port */;
   iir = inpt(baseport+UART_IIR);
 
   pic_end_int();                /* notify PIC that its part is done */
-  debug_log("*");
+  record(tty, TTYEV_IIR, iir);
+  count_iir(tty, iir);
+  while (inpt(baseport+UART_LSR) & UART_LSR_DR) { /* empty the rx FIFO */
+    ch = inpt(baseport+UART_RX);
+    record(tty, TTYEV_RX, ch);
+    rx_raw(tty, ch);
+  }
+  kick_tx(baseport, tty);	/* refill tx FIFO, re-arm interrupts */
+  run_bh();
+}
 
+static void count_iir(struct tty *tty, int iir)
+{
+  tty->stats.ints++;
   switch (iir & UART_IIR_ID) {
-    case UART_IIR_RDI:
-      ch = inpt(baseport+UART_RX);
-      enqueue(&inQueue, ch); // add to input queue
-      if (tty->echoflag)
-        enqueue(&echoQueue, ch); // add to echo queue
-
+    case UART_IIR_RDI:		/* also the FIFO timeout interrupt */
+      tty->stats.rxints++;
+      break;
     case UART_IIR_THRI:
-      if (queuecount(&echoQueue))
-        outpt(baseport+UART_TX, dequeue(&echoQueue));
-      if (queuecount(&outQueue)) {
-        outpt(baseport+UART_TX, dequeue(&outQueue));
+      tty->stats.txints++;
+      break;
+  }
+}
+
+static void rx_raw(struct tty *tty, int ch)
+{
+  struct rawring *raw = &tty->raw;
+
+  tty->stats.rxchars++;
+  if (raw->head - raw->tail < RAWBUF) {
+    if (tty->tsmode)
+      raw->tsc[raw->head & (RAWBUF-1)] = rdtsc();
+    raw->ch[raw->head++ & (RAWBUF-1)] = ch;
+  } else
+    tty->stats.rxdropped++;
+}
+
+/* run tty_bh with ints on, unless this interrupt came in on top of
+ * it (then it will see our chars before it returns) */
+static void run_bh(void)
+{
+  if (!bh_running) {
+    bh_running = 1;
+    tty_bh();
+    bh_running = 0;
+  }
+}
+
+/* The deferred part: per-char input processing for both ports, with
+ * ints on, so the other port's ISR (and the timer's) can get in.
+ * Called with ints off, returns with them off.  Task-level code
+ * uses inq etc. only with ints off, so while we run nobody else
+ * does, except the hard ISR, which we keep out where it shares. */
+static void tty_bh(void)
+{
+  struct tty *tty;
+  struct rawring *raw;
+  int dev, ch, more, plain, cls, idx;
+  unsigned int ts = 0;
+  unsigned long long since;
+
+  do {
+    more = 0;
+    sti();
+    for (dev = 0; dev < NTTYS; dev++) {
+      tty = &ttytab[dev];
+      raw = &tty->raw;
+      plain = tty->framing || tty->lz || tty->lzhello; /* binary */
+      if (raw->tail == raw->head)
+	continue;
+      debug_log("*");
+      while (raw->tail != raw->head) {
+	idx = raw->tail & (RAWBUF-1);
+	ch = raw->ch[idx] & 0xff;
+	if (tty->tsmode) {	/* time since the char before, dropped or not */
+	  since = (raw->tsc[idx] - tty->rxtsc) >> TTY_TSSHIFT;
+	  ts = since > TTY_TSMAX ? TTY_TSMAX : since;
+	  tty->rxtsc = raw->tsc[idx];
+	}
+	raw->tail++;
+	if (tty->framing)
+	  rx_frame(tty, ch);	// frames are not echoed
+	else {
+	  cls = 0;
+	  if (!plain) {
+	    ch = tty->xlate[ch];
+	    if ((cls = tty->cclass[ch]) & (TTYC_DROP | TTYC_KILL)) {
+	      /* an acquired span must stay put: leave the kill to
+	       * IOC_RELEASE, which skips at least this far */
+	      if (cls & TTYC_KILL) {
+		if (tty->acquired)
+		  tty->killed = queuecount(&tty->inq);
+		else
+		  queueskip(&tty->inq, queuecount(&tty->inq));
+	      }
+	      continue;
+	    }
+	  }
+	  if (enqueue(&tty->inq, ch) == FULLQUE) // add to input queue
+	    tty->stats.rxdropped++;
+	  else if (tty->tsmode)
+	    tty->rxts[tty->inq.rear] = ts; /* the slot ch went in */
+	  if (tty->echoflag && !(cls & TTYC_NOECHO)) {
+	    cli();		/* echoq is emptied by the hard ISR */
+	    enqueue(&tty->echoq, ch); // add to echo queue
+	    sti();
+	  }
+	}
       }
-        break;
+      cli();
+      task_wakeup(&tty->readers);
+      kick_tx(tty->baseport, tty); /* send any echoes */
+      sti();
+      more = 1;
+    }
+    cli();
+  } while (more);
+}
+
+/* Fill the tx FIFO if it is empty (echoes first), and keep THRI
+ * enabled only while there is more output queued.  Called with
+ * interrupts off. */
+static void kick_tx(int baseport, struct tty *tty)
+{
+  int n;
+  Queue *logq = log_out(tty);
+
+  if (inpt(baseport+UART_LSR) & UART_LSR_THRE) {
+    for (n = 0; n < TXFIFO; n++) {
+      if (queuecount(&tty->echoq))
+	outpt(baseport+UART_TX, dequeue(&tty->echoq));
+      else if (queuecount(&tty->outq))
+	outpt(baseport+UART_TX, dequeue(&tty->outq));
+      else if (tty->txchain) {
+	outpt(baseport+UART_TX, tty->txchain->data[tty->txoff++]);
+	if (tty->txoff == tty->txchain->len)
+	  chain_release(tty);
+      } else if (logq && queuecount(logq))
+	outpt(baseport+UART_TX, dequeue(logq));
+      else
+	break;
+      tty->stats.txchars++;
+    }
+  }
+  if (queuecount(&tty->echoq) || queuecount(&tty->outq) || tty->txchain ||
+      (logq && queuecount(logq)))
+    outpt(baseport+UART_IER, UART_IER_RDI | UART_IER_THRI);
+  else {
+    outpt(baseport+UART_IER, UART_IER_RDI); /* receiver interrupts only */
+    task_wakeup(&tty->writers);	/* all sent: for DRAINCONTROL */
+  }
+}
+
+static Queue *log_out(struct tty *tty)
+{
+  if (tty->framing || tty->lz || tty->lzhello)
+    return 0;
+  return tty->logq;
+}
+
+/* Link chain on after any chain still going out, and start sending.
+ * The CRC is over the data as queued, like ttywrite's. */
+static int write_chain(struct tty *tty, struct iobuf *chain)
+{
+  struct iobuf *b, *last;
+  int saved_eflags;
 
-    default:
-      debug_log("#");
+  if (chain == 0)
+    return 0;
+  saved_eflags = get_eflags();
+  cli();
+  write_lock(tty);		/* not into the middle of a write */
+  for (b = chain; b; b = b->next) {
+    tty->crc.tx = crc_add(tty, tty->crc.tx, b->data, b->len);
+    last = b;
   }
-  outpt(baseport+UART_IER, UART_IER_RDI); /* enable receiver interrupts again*/
+  if (tty->txchain)
+    tty->txlast->next = chain;
+  else {
+    tty->txchain = chain;
+    tty->txoff = 0;
+    if (chain->len <= 0)
+      chain_release(tty);	/* nothing in it to send */
+  }
+  if (tty->txchain)
+    tty->txlast = last;
+  kick_tx(tty->baseport, tty);
+  write_unlock(tty);
+  set_eflags(saved_eflags);
+  return 0;
 }
 
-/* append msg to memory log */
+/* The first buffer is all in the UART: unlink it before calling its
+ * done (which may queue it again), then any empty ones after it.
+ * Called with ints off. */
+static void chain_release(struct tty *tty)
+{
+  struct iobuf *b;
+
+  do {
+    b = tty->txchain;
+    tty->txchain = b->next;
+    tty->txoff = 0;
+    if (b->done)
+      b->done(b);
+  } while (tty->txchain && tty->txchain->len <= 0);
+  if (tty->txchain == 0)
+    task_wakeup(&tty->writers);	/* ttywrite waits for the chain */
+}
+
+/* RTS down as inq nears full, up again once it is mostly read; called
+ * from tty_bh (ints on, but the hard ISR leaves MCR alone) or with
+ * ints off */
+static void inq_mark(Queue *q, int which, void *arg)
+{
+  set_rts((struct tty *)arg, which == QUEUE_LOW);
+}
+
+static void outq_mark(Queue *q, int which, void *arg)
+{
+  if (which == QUEUE_LOW)
+    task_wakeup(&((struct tty *)arg)->writers);
+}
+
+static void set_rts(struct tty *tty, int on)
+{
+  int mcr = inpt(tty->baseport+UART_MCR);
+
+  if (on)
+    outpt(tty->baseport+UART_MCR, mcr | UART_MCR_RTS);
+  else
+    outpt(tty->baseport+UART_MCR, mcr & ~UART_MCR_RTS);
+}
+
+/* Decode one char; a complete frame goes into inq only if all of it
+ * fits, with its length in flen, so read always sees whole frames. */
+static void rx_frame(struct tty *tty, int ch)
+{
+  int len, i;
+
+  if ((len = frame_rx(&tty->rxframe, ch)) == FRAME_MORE)
+    return;
+  if (len == FRAME_BAD || rqueuecount(&tty->flen) == NFRAMES ||
+      len > tty->inq.max - 1 - queuecount(&tty->inq)) {
+    tty->stats.rxbadframes++;
+    return;
+  }
+  for (i = 0; i < len; i++)
+    enqueue(&tty->inq, tty->rxframe.buf[i]);
+  renqueue(&tty->flen, &len);
+  tty->stats.rxframes++;
+}
+
+/* Wait for a frame and return it; the part that won't fit in buf
+ * is discarded. */
+static int read_frame(struct tty *tty, char *buf, int nchar)
+{
+  int saved_eflags, len, i, ch;
+  unsigned long long wait_start;
+
+  saved_eflags = get_eflags();
+  cli();
+  while (rdequeue(&tty->flen, &len) == EMPTYQUE) {
+    wait_start = rdtsc();
+    task_sleep(&tty->readers);	/* ISR wakes us on input */
+    tty->stats.waitcycles += rdtsc() - wait_start;
+  }
+  for (i = 0; i < len; i++) {
+    ch = dequeue(&tty->inq);
+    if (i < nchar)
+      buf[i] = ch;
+  }
+  len = len < nchar ? len : nchar;
+  tty->crc.rx = crc_add(tty, tty->crc.rx, buf, len);
+  set_eflags(saved_eflags);
+  return len;
+}
+
+/* Wait until inq holds the delimiter, or enough to fill buf, then
+ * copy it out in spans.  A record longer than inq is taken in
+ * pieces, a full queue at a time. */
+static int read_until(struct tty *tty, char *buf, int max, int delim)
+{
+  int saved_eflags, got, n, want, i, span;
+  unsigned long long wait_start;
+  char *p;
+
+  saved_eflags = get_eflags();
+  cli();
+  got = 0;
+  while (got < max) {
+    want = max - got;
+    if ((n = queuefind(&tty->inq, delim, want)) == 0) {
+      n = queuecount(&tty->inq);
+      if (n < want && n < tty->inq.max - 1) { /* more to come, room for it */
+	wait_start = rdtsc();
+	task_sleep(&tty->readers);	/* ISR wakes us on input */
+	tty->stats.waitcycles += rdtsc() - wait_start;
+	continue;
+      }
+      if (n > want)
+	n = want;
+    } else
+      max = got + n;		/* the delimiter ends it */
+    while (n > 0) {
+      span = queuespan(&tty->inq, &p);
+      if (span > n)
+	span = n;
+      for (i = 0; i < span; i++)
+	buf[got + i] = p[i];
+      queueskip(&tty->inq, span);
+      got += span;
+      n -= span;
+    }
+  }
+  tty->crc.rx = crc_add(tty, tty->crc.rx, buf, got);
+  set_eflags(saved_eflags);
+  return got;
+}
+
+/* Like ttyread, also giving each char's time from its inq slot. */
+static int read_ts(struct tty *tty, char *buf, unsigned short *ts,
+		   int nchar)
+{
+  int saved_eflags, i;
+  unsigned long long wait_start;
+
+  saved_eflags = get_eflags();
+  cli();
+  i = 0;
+  while (i < nchar) {
+    if (queuecount(&tty->inq)) {
+      ts[i] = tty->rxts[tty->inq.front];
+      buf[i++] = dequeue(&tty->inq);
+    } else {
+      wait_start = rdtsc();
+      task_sleep(&tty->readers);	/* ISR wakes us on input */
+      tty->stats.waitcycles += rdtsc() - wait_start;
+    }
+  }
+  tty->crc.rx = crc_add(tty, tty->crc.rx, buf, nchar);
+  set_eflags(saved_eflags);
+  return nchar;
+}
+
+/* called with ints off */
+static void flush_input(struct tty *tty)
+{
+  init_queue(&tty->inq, tty->framing ? FRAMEQBUF : MAXBUF);
+  if (tty->flow)
+    queue_watermarks(&tty->inq, tty->inq.max - 1 - FLOWMARGIN,
+		     (tty->inq.max - 1) / 4, inq_mark, tty);
+  set_rts(tty, 1);
+  tty->killed = 0;
+  tty->raw.tail = tty->raw.head;
+  frame_reset(&tty->rxframe, tty->framing);
+  init_rqueue(&tty->flen, tty->flenbuf, sizeof(int), NFRAMES);
+  tty->stats.inqsize = tty->inq.max - 1;
+}
+
+/* Decompress until nchar chars are out, finishing any copy left
+ * from the last read first. */
+static int read_lz(struct tty *tty, char *buf, int nchar)
+{
+  int saved_eflags, i, ch;
+  unsigned long long wait_start;
+
+  saved_eflags = get_eflags();
+  cli();
+  i = 0;
+  while (i < nchar) {
+    if ((ch = lz_next(&tty->lzdec)) != LZ_NONE)
+      buf[i++] = ch;
+    else if ((ch = dequeue(&tty->inq)) != EMPTYQUE) {
+      if ((ch = lz_input(&tty->lzdec, ch)) != LZ_NONE)
+	buf[i++] = ch;
+    } else {
+      wait_start = rdtsc();
+      task_sleep(&tty->readers);	/* ISR wakes us on input */
+      tty->stats.waitcycles += rdtsc() - wait_start;
+    }
+  }
+  tty->crc.rx = crc_add(tty, tty->crc.rx, buf, nchar);
+  set_eflags(saved_eflags);
+  return nchar;
+}
+
+static int inq_peek(void *arg, int k)
+{
+  int ch = queuepeek((Queue *)arg, k);
+
+  return ch == EMPTYQUE ? LZ_NONE : ch;
+}
+
+/* Send LZHELLO, then discard input up through the other end's
+ * LZHELLO: everything after that is compressed, as is everything we
+ * send from now on.  Echo is turned off, since an echoed LZHELLO
+ * would look like agreement, and echoes in the compressed stream
+ * would garble it; it comes back if this fails, or at LZCONTROL 0.
+ * Input is binary from our LZHELLO on, since what follows theirs is
+ * compressed and must not meet the translation or class tables. */
+static int lz_negotiate(struct tty *tty)
+{
+  char *hello = LZHELLO;
+  int saved_eflags, i, ch, matched;
+  unsigned int deadline;
+
+  saved_eflags = get_eflags();
+  cli();
+  if (!tty->lz)			/* else it's saved already */
+    tty->lzecho = tty->echoflag;
+  tty->lz = 0;
+  tty->echoflag = 0;		/* the hellos are not for echoing */
+  tty->lzhello = 1;
+  write_lock(tty);
+  for (i = 0; hello[i]; i++)
+    tx_put(tty, hello[i]);
+  write_unlock(tty);
+  deadline = pit_ticks() + LZTIMEOUT;
+  matched = 0;
+  while (hello[matched]) {
+    if ((ch = dequeue(&tty->inq)) == EMPTYQUE) {
+      if ((int)(pit_ticks() - deadline) >= 0) {
+	tty->echoflag = tty->lzecho;
+	tty->lzhello = 0;
+	kick_tx(tty->baseport, tty); /* the log, if it was held */
+	set_eflags(saved_eflags);
+	return -1;		/* nobody there, or they don't speak LZ */
+      }
+      pit_sleep(1);
+    } else if (ch == hello[matched])
+      matched++;
+    else
+      matched = ch == hello[0];
+  }
+  lz_enc_init(&tty->lzenc);
+  lz_dec_init(&tty->lzdec);
+  tty->lz = 1;
+  tty->lzhello = 0;
+  set_eflags(saved_eflags);
+  return 0;
+}
+
+static unsigned int crc_add(struct tty *tty, unsigned int crc,
+			    char *buf, int n)
+{
+  if (tty->crcmode == CRC_16)
+    return crc16(crc, buf, n);
+  if (tty->crcmode == CRC_32)
+    return crc32(crc, buf, n);
+  return crc;
+}
+
+/* Copy the tables in, so the app's can go away; the driver's are
+ * changed with ints off, since tty_bh reads them with ints on. */
+static void set_table(unsigned char *table, char *src, int identity)
+{
+  int saved_eflags, i;
+
+  saved_eflags = get_eflags();
+  cli();
+  for (i = 0; i < 256; i++)
+    table[i] = src ? src[i] : identity ? i : 0;
+  set_eflags(saved_eflags);
+}
+
+/* zero the counters, keeping the queue sizes */
+static void clear_stats(struct tty *tty)
+{
+  char *p = (char *)&tty->stats;
+  unsigned int i;
+
+  for (i = 0; i < sizeof(struct ttystats); i++)
+    p[i] = 0;
+  tty->stats.inqsize = tty->inq.max - 1;
+  tty->stats.outqsize = tty->outq.max - 1;
+  tty->echoq.overwritten = 0;
+}
+
+/*====================================================================
+*       record and replay
+====================================================================*/
+
+/* hard ISR: add an event, if this tty is being recorded */
+static void record(struct tty *tty, int type, int data)
+{
+  unsigned long long now, since;
+  struct ttyevent *e;
+
+  if (rec.tty != tty)
+    return;
+  if (rec.n == RECBUF) {
+    rec.lost++;
+    return;
+  }
+  now = rdtsc();
+  since = now - rec.last;
+  rec.last = now;
+  e = &rec.ev[rec.n++];
+  e->cycles = since > 0xffffffff ? 0xffffffff : since;
+  e->type = type;
+  e->data = data;
+}
+
+/* PIT timer, each tick: deliver the events whose time has come, as
+ * the hard ISR would have, so the timing is kept to within a tick.
+ * Timer callbacks run with ints off and must keep them off, so this
+ * only fills raw, and the PIT ISR runs tty_bh after its timers. */
+static void replay_tick(void *arg)
+{
+  struct ttyevent *e;
+
+  play.budget += play.cycles_per_tick;
+  while (play.next < play.n && play.ev[play.next].cycles <= play.budget) {
+    e = &play.ev[play.next++];
+    play.budget -= e->cycles;
+    if (e->type == TTYEV_RX)
+      rx_raw(play.tty, e->data);
+    else
+      count_iir(play.tty, e->data);
+  }
+  if (play.next == play.n) {
+    pit_timer_stop(&play.timer);
+    play.tty = 0;
+  }
+  bh_timer = 1;
+}
+
+/*====================================================================
+*       calls for other kernel code
+====================================================================*/
+
+int tty_attach_log(int dev, Queue *q)
+{
+  struct tty *tty = (struct tty *)devtab[dev].dvdata;
+  int saved_eflags;
+
+  if (tty->framing || tty->lz)
+    return -1;			/* log text would corrupt the stream */
+  saved_eflags = get_eflags();
+  cli();
+  tty->logq = q;
+  set_eflags(saved_eflags);
+  return 0;
+}
+
+void tty_kick(int dev)
+{
+  struct tty *tty = (struct tty *)devtab[dev].dvdata;
+
+  kick_tx(tty->baseport, tty);
+}
+
+void tty_timer_bh(void)
+{
+  if (bh_timer) {
+    bh_timer = 0;
+    run_bh();
+  }
+}
+
+/* append msg to memory log: the space is claimed with cmpxchg, so
+ * a caller interrupted here by another can't be overwritten by it */
 void debug_log(char *msg)
 {
-    strcpy(debug_record, msg);
-    debug_record +=strlen(msg);
+    char *old, *at;
+    int len = strlen(msg), i;
+
+    do {
+      at = old = debug_record;
+      if (at + len >= debug_log_area + DEBUG_AREA_SIZE)
+	at = debug_log_area; /* long runs: start over */
+    } while (!__sync_bool_compare_and_swap(&debug_record, old, at + len));
+    for (i = 0; i < len; i++)
+      at[i] = msg[i];
+    if (debug_record == at + len)
+      at[len] = 0;		/* still the end of the log */
 }
@@ -7,23 +7,139 @@
 *       apps should not include this header
 *
 *       2/24/2021 - removed circular buffer logic
+*       queues and counters are now kept per device, so both
+*       COM ports can be used at once
+*       read/write block in wait queues, woken by the ISR
+*       larger input queue in framing mode, for windowed protocols
+*       ISR only moves chars: raw rx ring, processed in tty_bh()
+*       klog ring sent after outq (tty_attach_log, for klog.c)
+*       record/replay of input events (RECORDCONTROL, REPLAYCONTROL)
+*       input translation and class tables (XLATECONTROL, CLASSCONTROL)
+*       per-char input timestamps (TSCONTROL, for readts)
+*       chained caller buffers sent in place, after outq (writechain)
+*       queue watermarks: writers woken at half empty, RTS flow control
 *
 */
 
 #ifndef TTY_H
 #define TTY_H
-#define MAXBUF 6
+
+#include "tty_public.h"
+#include "queue/queue.h"
+#include "queue/rqueue.h"
+#include "task.h"
+#include "frame.h"
+#include "crc.h"
+#include "lz.h"
+#include "pit.h"
+
+#define MAXBUF 64		/* several rx FIFO loads: tty_bh fills inq
+				   faster than a task can empty it */
+#define NFRAMES 16		/* most frames waiting in inq at once */
+#define FRAMEQBUF 1000		/* inq size in framing mode: several frames */
+#define LZHELLO "\033LZ1"	/* sent both ways to start compression */
+#define LZTIMEOUT (3*HZ)	/* how long to wait for the other end */
+#define RAWBUF 64		/* raw rx ring, power of two */
+#define TXFIFO 16		/* 16550 transmit FIFO depth */
+#define RECBUF 4096		/* events in a recording */
+#define FLOWMARGIN 24		/* inq room left when RTS drops: the rest
+				   of tty_bh's batch, and what the far
+				   end sends before it sees CTS drop */
+
+/* FIFO control bits, in case serial.h predates the 16550 */
+#ifndef UART_FCR_ENABLE_FIFO
+#define UART_FCR_ENABLE_FIFO 0x01
+#define UART_FCR_CLEAR_RCVR 0x02
+#define UART_FCR_CLEAR_XMIT 0x04
+#define UART_FCR_TRIGGER_1 0x00
+#define UART_FCR_TRIGGER_8 0x80
+#endif
+
+/* chars the ISR took from the UART, for tty_bh: the ISR only
+ * advances head and tty_bh only tail, so neither needs a lock */
+struct rawring {
+  char ch[RAWBUF];
+  unsigned long long tsc[RAWBUF]; /* when each was taken, in TSCONTROL mode */
+  volatile unsigned int head;	/* free-running counts, */
+  volatile unsigned int tail;	/*   index with & (RAWBUF-1) */
+};
 
 struct tty {
+  int baseport;			/* hardware addr, from devtab */
   int echoflag;			/* echo chars in read */
+  Queue inq;			/* chars received, waiting for read */
+  Queue outq;			/* chars written, waiting for the UART */
+  Queue echoq;			/* chars to echo, sent ahead of outq */
+  struct rawring raw;		/* received, not yet through tty_bh */
+  struct iobuf *txchain;	/* writechain buffers, sent after outq, */
+  struct iobuf *txlast;		/*   the last one, */
+  int txoff;			/*   and how far into the first we are */
+  Queue *logq;			/* klog output, sent after the chain, or 0, */
+				/*   held while framing or lz */
+  struct ttystats stats;	/* counters for STATSCONTROL */
+  struct waitq readers;		/* tasks waiting for input */
+  struct waitq writers;		/* tasks waiting for output queue space */
+  int wlock;			/* a write is queueing its chars, */
+  struct waitq wlockq;		/*   and other writes wait here */
+  int framing;			/* FRAME_NONE, FRAME_SLIP or FRAME_COBS */
+  struct framer rxframe;	/* receive side frame decoder */
+  RQueue flen;			/* int lengths of the frames in inq */
+  int flenbuf[NFRAMES];		/*   (its storage) */
+  int crcmode;			/* CRC_NONE, CRC_16 or CRC_32 */
+  struct ttycrc crc;		/* running CRCs */
+  int lz;			/* stream is compressed both ways */
+  int lzhello;			/* negotiating: input is binary from */
+				/*   our LZHELLO on */
+  int lzecho;			/* echoflag, put back when lz ends */
+  struct lzenc lzenc;		/* write side compressor */
+  struct lzdec lzdec;		/* read side decompressor */
+  unsigned char xlate[256];	/* input char -> char queued */
+  unsigned char cclass[256];	/* TTYC_ bits, by translated char */
+  int acquired;			/* inq span is out to read_acquire */
+  int killed;			/* chars a kill left at the front of inq, */
+				/*   for IOC_RELEASE to skip */
+  int flow;			/* RTS flow control (FLOWCONTROL) */
+  int tsmode;			/* timing input chars (TSCONTROL) */
+  unsigned long long rxtsc;	/* TSC at the last char taken */
+  unsigned short rxts[MAXCHARBUF]; /* readts time of the char in the same
+				   inq slot */
 };
 
 extern struct tty ttytab[];
 
+/* input being recorded by the hard ISR */
+struct recorder {
+  struct tty *tty;		/* being recorded, or 0 */
+  struct ttyevent ev[RECBUF];
+  int n;
+  int lost;
+  unsigned long long last;	/* TSC at the previous event */
+};
+
+/* a recording being fed to tty_bh, by a PIT timer every tick */
+struct replayer {
+  struct tty *tty;		/* being played into, or 0 */
+  struct ttyevent *ev;
+  int n;
+  int next;			/* next event to play */
+  unsigned long long budget;	/* cycles of play time not yet used */
+  unsigned int cycles_per_tick;
+  struct pit_timer timer;
+};
+
 /* tty-specific device functions */
 void ttyinit(int dev);
 int ttyread(int dev, char *buf, int nchar);
 int ttywrite(int dev, char *buf, int nchar);
 int ttycontrol(int dev, int fncode, int val);
 
+/* calls for other kernel code */
+/* also send q's chars (after queued output), except while framing
+   or LZ is on; -1 if one is on now */
+int tty_attach_log(int dev, Queue *q);
+/* start sending, if idle; call with ints off */
+void tty_kick(int dev);
+/* from the PIT ISR, after its timers: process input they fed in */
+void tty_timer_bh(void);
+
 #endif
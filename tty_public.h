@@ -17,7 +17,96 @@
 #define	TTY0     0			/* type tty      */
 #define	TTY1     1			/* type tty      */
 
-#define ECHOCONTROL 1
+/* control function codes (second arg of control) */
+#define ECHOCONTROL 1		/* val: 1 = echo input, 0 = no echo */
+#define LOOPCONTROL 2		/* val: 1 = UART internal loopback, 0 = off */
+#define FLUSHCONTROL 3		/* discard unread input */
+#define DRAINCONTROL 4		/* wait until all output has left the UART */
+#define STATSCONTROL 5		/* val: struct ttystats * to fill in */
+#define STATSRESET 6		/* zero the counters in struct ttystats */
+#define FRAMECONTROL 7		/* val: FRAME_NONE, FRAME_SLIP, FRAME_COBS */
+#define CRCCONTROL 8		/* val: CRC_NONE, CRC_16, CRC_32; resets */
+#define CRCRESET 9		/* restart both running CRCs */
+#define CRCGET 10		/* val: struct ttycrc * to fill in */
+#define LZCONTROL 11		/* val: 1 = agree on compression with the
+				   other end (which must do the same within
+				   a few seconds), 0 = stop; -1 if no deal */
+#define READYCONTROL 12		/* returns frames (framing mode) or chars
+				   read could take now without waiting */
+#define RECORDCONTROL 13	/* val: 1 = start recording input events
+				   (one tty at a time), 0 = stop */
+#define RECGETCONTROL 14	/* val: struct ttyrec * to fill in with
+				   the recording, valid until the next one */
+#define REPLAYCONTROL 15	/* val: struct ttyrec * to play back as
+				   input, 0 = stop (returns events left) */
+#define XLATECONTROL 16		/* val: char[256] input translation table
+				   (copied), 0 = none; not in framing/LZ */
+#define CLASSCONTROL 17		/* val: char[256] TTYC_ bits for each
+				   (translated) input char, 0 = all plain */
+#define TSCONTROL 18		/* val: 1 = time each input char, for
+				   readts (an rx interrupt per char), 0 = off */
+#define FLOWCONTROL 19		/* val: 1 = drop RTS while the input queue
+				   is nearly full, for a far end that
+				   honors CTS; 0 = leave RTS up */
+
+/* input char classes, for CLASSCONTROL */
+#define TTYC_DROP 0x01		/* discard it */
+#define TTYC_NOECHO 0x02	/* queue it, but don't echo it */
+#define TTYC_KILL 0x04		/* discard it and all unread input */
+
+/* readts times: TSC cycles since the char before, >> TTY_TSSHIFT
+ * (about a microsecond per unit at 1 GHz), at most TTY_TSMAX */
+#define TTY_TSSHIFT 10
+#define TTY_TSMAX 0xffff
+
+/* framing modes: read returns one whole frame, write sends one */
+#define FRAME_NONE 0		/* plain byte stream */
+#define FRAME_SLIP 1		/* RFC 1055 */
+#define FRAME_COBS 2		/* consistent overhead byte stuffing */
+#define FRAMEMAX 96		/* longest frame, after decoding */
+
+/* running CRCs over the data read and written, as the app sees it
+ * (before framing); see crc.h for the exact CRC-16 and CRC-32 */
+#define CRC_NONE 0
+#define CRC_16 1
+#define CRC_32 2
+
+struct ttycrc {
+  unsigned int rx;		/* over everything read since reset */
+  unsigned int tx;		/* over everything written since reset */
+};
+
+/* recorded input: what the UART interrupts delivered, and when */
+#define TTYEV_RX 1		/* data: a received char */
+#define TTYEV_IIR 2		/* data: IIR at an interrupt */
+
+struct ttyevent {
+  unsigned int cycles;		/* TSC cycles since the previous event */
+  unsigned char type;		/* TTYEV_RX or TTYEV_IIR */
+  unsigned char data;
+};
+
+struct ttyrec {
+  struct ttyevent *ev;		/* events, oldest first */
+  int n;
+  int lost;			/* recording: events that didn't fit */
+};
+
+/* driver counters, for measuring performance */
+struct ttystats {
+  unsigned int ints;		/* interrupts taken */
+  unsigned int rxints;		/* receiver interrupts */
+  unsigned int txints;		/* transmitter interrupts */
+  unsigned int rxchars;		/* chars taken from the UART */
+  unsigned int txchars;		/* chars given to the UART (incl. echoes) */
+  unsigned int rxdropped;	/* input chars lost to a full queue */
+  unsigned int rxframes;	/* frames received */
+  unsigned int rxbadframes;	/* malformed, or no room: discarded */
+  unsigned int echolost;	/* echoes overwritten by newer input */
+  unsigned long long waitcycles; /* TSC cycles read/write spent waiting */
+  int inqsize;			/* input queue capacity */
+  int outqsize;			/* output queue capacity */
+};
 
 #endif
 
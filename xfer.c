@@ -0,0 +1,250 @@
+/*********************************************************************
+*
+*       file:           xfer.c
+*       author:         paul cardoos
+*
+*       sliding-window file transfer over io_public.h (ZMODEM-like)
+*
+*       The tty is put in COBS framing mode; each frame is
+*         type, block number (2 bytes, little-endian), payload, CRC-16
+*       with types
+*         D  data: up to XFER_BLK bytes of block n
+*         A  ack: every block before n has arrived
+*         N  nak: block n is missing (later ones have arrived)
+*         E  end: payload is length (4) and CRC-32 of the image (4)
+*         F  fin: n is 1 if the image CRC-32 matched, 0 if not
+*
+*       The sender keeps up to XFER_WINDOW blocks unacknowledged and
+*       resends just the block a NAK names, or the oldest one on a
+*       timeout.  A NAK acks the blocks before the one it names.  The
+*       receiver NAKs a gap once, then acks until it fills (a lost
+*       resend is left to the timeout), and the sender holds off
+*       resending for a NAK that comes soon after the last send, so
+*       one lost block costs one resend.  The receiver stores
+*       out-of-order blocks in place (buf is memory, not a pipe), and
+*       folds blocks into the image CRC-32 as they become contiguous.
+*
+*/
+#include "io_public.h"
+#include "crc.h"
+#include "xfer.h"
+
+#define HDR 3			/* type, block number */
+#define FCS 2			/* CRC-16 */
+
+static void send_frame(int dev, int type, int n, char *data, int len);
+static int recv_frame(int dev, char *f, int *type, int *n);
+static int ticks(void);
+static void put4(char *p, unsigned int v);
+static unsigned int get4(char *p);
+
+/*====================================================================
+*       sender
+====================================================================*/
+
+int xfer_send(int dev, char *buf, int len)
+{
+  int nblocks, base, next, i, len_i, type, n, plen, tries;
+  int sent_at[XFER_WINDOW];	/* tick each window slot was last sent */
+  int retries[XFER_WINDOW];	/* and how often since, NAK or timeout */
+  char f[FRAMEMAX], g[FRAMEMAX];
+  unsigned int crc = 0;
+
+  if (len < 0 || len > XFER_MAXBLKS * XFER_BLK)
+    return -1;			/* the block numbers would wrap */
+  crc_init();
+  if (control(dev, FRAMECONTROL, FRAME_COBS) < 0)
+    return -1;
+  nblocks = (len + XFER_BLK - 1) / XFER_BLK;
+  base = next = 0;
+  while (base < nblocks) {
+    /* fill the window */
+    while (next < nblocks && next < base + XFER_WINDOW) {
+      len_i = next == nblocks - 1 ? len - next * XFER_BLK : XFER_BLK;
+      crc = crc32(crc, buf + next * XFER_BLK, len_i); /* in order, once */
+      send_frame(dev, 'D', next, buf + next * XFER_BLK, len_i);
+      sent_at[next % XFER_WINDOW] = ticks();
+      retries[next % XFER_WINDOW] = 0;
+      next++;
+    }
+    if (control(dev, READYCONTROL, 0) > 0) {
+      plen = recv_frame(dev, f, &type, &n);
+      if (plen < 0)
+	continue;		/* damaged: a timeout will cover it */
+      if ((type == 'A' || type == 'N') && n > base)
+	base = n <= next ? n : next;	/* both ack what is before n */
+      i = n % XFER_WINDOW;	/* the line keeps order, so a first
+				   NAK means lost; after a resend, a
+				   NAK may be from before it */
+      if (type == 'N' && n >= base && n < next &&
+	  (retries[i] == 0 || ticks() - sent_at[i] >= XFER_HOLDOFF)) {
+	len_i = n == nblocks - 1 ? len - n * XFER_BLK : XFER_BLK;
+	send_frame(dev, 'D', n, buf + n * XFER_BLK, len_i);
+	sent_at[i] = ticks();
+	retries[i]++;
+      }
+    } else if (ticks() - sent_at[base % XFER_WINDOW] >= XFER_TIMEOUT) {
+      i = base % XFER_WINDOW;
+      if (++retries[i] > XFER_RETRIES)
+	goto fail;
+      len_i = base == nblocks - 1 ? len - base * XFER_BLK : XFER_BLK;
+      send_frame(dev, 'D', base, buf + base * XFER_BLK, len_i);
+      sent_at[i] = ticks();
+    } else
+      control(PIT0, SLEEPCONTROL, 1);
+  }
+
+  /* all acked: send END until FIN */
+  put4(f, len);
+  put4(f + 4, crc);
+  for (tries = 0; tries <= XFER_RETRIES; tries++) {
+    send_frame(dev, 'E', nblocks, f, 8);
+    i = ticks();
+    while (ticks() - i < XFER_TIMEOUT) {
+      if (control(dev, READYCONTROL, 0) == 0) {
+	control(PIT0, SLEEPCONTROL, 1);
+	continue;
+      }
+      if (recv_frame(dev, g, &type, &n) >= 0 && type == 'F') {
+	control(dev, FRAMECONTROL, FRAME_NONE);
+	return n ? len : -1;
+      }
+    }
+  }
+ fail:
+  control(dev, FRAMECONTROL, FRAME_NONE);
+  return -1;
+}
+
+/*====================================================================
+*       receiver
+====================================================================*/
+
+int xfer_recv(int dev, char *buf, int max)
+{
+  int expected, type, n, plen, i, len, ok, until, heard;
+  int naked;			/* the gap NAKed last, or -1 */
+  char got[XFER_WINDOW];	/* blocks expected.. that have arrived */
+  int blen[XFER_WINDOW];	/* and their lengths */
+  char f[FRAMEMAX];
+  unsigned int crc = 0;
+
+  crc_init();
+  if (control(dev, FRAMECONTROL, FRAME_COBS) < 0)
+    return -1;
+  for (i = 0; i < XFER_WINDOW; i++)
+    got[i] = 0;
+  expected = 0;
+  naked = -1;
+  heard = ticks();
+  for (;;) {
+    if (control(dev, READYCONTROL, 0) == 0) {
+      if (ticks() - heard >= XFER_IDLE)
+	break;			/* the sender has given up, or never came */
+      control(PIT0, SLEEPCONTROL, 1);
+      continue;
+    }
+    if ((plen = recv_frame(dev, f, &type, &n)) < 0)
+      continue;
+    heard = ticks();
+    if (type == 'D') {
+      if (n >= expected && n < expected + XFER_WINDOW &&
+	  n * XFER_BLK + plen <= max && !got[n % XFER_WINDOW]) {
+	for (i = 0; i < plen; i++)
+	  buf[n * XFER_BLK + i] = f[HDR + i];
+	got[n % XFER_WINDOW] = 1;
+	blen[n % XFER_WINDOW] = plen;
+	while (got[expected % XFER_WINDOW]) { /* slide the window */
+	  got[expected % XFER_WINDOW] = 0;
+	  crc = crc32(crc, buf + expected * XFER_BLK,
+		      blen[expected % XFER_WINDOW]);
+	  expected++;
+	}
+      }
+      if (n > expected && expected != naked) { /* a new gap: ask once */
+	send_frame(dev, 'N', expected, 0, 0);
+	naked = expected;
+      } else
+	send_frame(dev, 'A', expected, 0, 0);
+    } else if (type == 'E' && plen == 8) {
+      if (n > expected) {
+	send_frame(dev, 'N', expected, 0, 0);
+	continue;
+      }
+      len = get4(f + HDR);
+      ok = len <= max && get4(f + HDR + 4) == crc;
+      send_frame(dev, 'F', ok, 0, 0);
+      /* stay a while in case the FIN is lost and END comes again */
+      until = ticks() + XFER_LINGER;
+      while (ticks() - until < 0) {
+	if (control(dev, READYCONTROL, 0) == 0) {
+	  control(PIT0, SLEEPCONTROL, 1);
+	  continue;
+	}
+	if (recv_frame(dev, f, &type, &n) >= 0 && type == 'E')
+	  send_frame(dev, 'F', ok, 0, 0);
+      }
+      control(dev, FRAMECONTROL, FRAME_NONE);
+      return ok ? len : -1;
+    }
+  }
+  control(dev, FRAMECONTROL, FRAME_NONE);
+  return -1;
+}
+
+/*====================================================================
+*       frames
+====================================================================*/
+
+static void send_frame(int dev, int type, int n, char *data, int len)
+{
+  char f[FRAMEMAX];
+  unsigned int fcs;
+  int i;
+
+  f[0] = type;
+  f[1] = n & 0xff;
+  f[2] = n >> 8;
+  for (i = 0; i < len; i++)
+    f[HDR + i] = data[i];
+  fcs = crc16(0, f, HDR + len);
+  f[HDR + len] = fcs & 0xff;
+  f[HDR + len + 1] = fcs >> 8;
+  write(dev, f, HDR + len + FCS);
+}
+
+/* read a frame into f; returns payload length, or -1 if damaged */
+static int recv_frame(int dev, char *f, int *type, int *n)
+{
+  int len;
+  unsigned int fcs;
+
+  len = read(dev, f, FRAMEMAX);
+  if (len < HDR + FCS)
+    return -1;
+  fcs = (f[len - 2] & 0xff) | (f[len - 1] & 0xff) << 8;
+  if (crc16(0, f, len - FCS) != fcs)
+    return -1;
+  *type = f[0];
+  *n = (f[1] & 0xff) | (f[2] & 0xff) << 8;
+  return len - HDR - FCS;
+}
+
+static int ticks(void)
+{
+  return control(PIT0, TICKCONTROL, 0);
+}
+
+static void put4(char *p, unsigned int v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static unsigned int get4(char *p)
+{
+  return (p[0] & 0xff) | (p[1] & 0xff) << 8 | (p[2] & 0xff) << 16 |
+    (unsigned int)(p[3] & 0xff) << 24;
+}
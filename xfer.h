@@ -0,0 +1,34 @@
+/*********************************************************************
+*
+*       file:           xfer.h
+*       author:         paul cardoos
+*
+*       sliding-window reliable transfer of a memory image between
+*       two SAPCs (or a host running the same protocol) over a tty
+*
+*/
+
+#ifndef XFER_H
+#define XFER_H
+
+#define XFER_BLK 64		/* data bytes per block */
+#define XFER_WINDOW 8		/* blocks sent ahead of the oldest unacked */
+#define XFER_TIMEOUT HZ		/* ticks before resending a block */
+#define XFER_RETRIES 10		/* resends of one block before giving up */
+#define XFER_HOLDOFF (XFER_TIMEOUT / 4) /* ticks before a NAK may resend
+					   a block resent already */
+#define XFER_MAXBLKS 65535	/* block numbers are 16 bits on the wire,
+				   and END carries the count */
+#define XFER_LINGER HZ		/* receiver: ticks to re-answer a lost FIN */
+/* receiver: ticks without a good frame before giving up, longer
+   than the sender keeps resending one block */
+#define XFER_IDLE ((XFER_RETRIES + 1) * XFER_TIMEOUT)
+
+/* send len bytes of buf to dev (at most XFER_MAXBLKS blocks);
+   returns len, or -1 on failure */
+int xfer_send(int dev, char *buf, int len);
+/* receive into buf (at most max bytes); returns length, or -1,
+   also when nothing good comes for XFER_IDLE ticks */
+int xfer_recv(int dev, char *buf, int max);
+
+#endif